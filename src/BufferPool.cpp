@@ -0,0 +1,141 @@
+#include "BufferPool.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <vector>
+#include <sys/mman.h>
+
+static std::atomic<bool> huge_pages{false};
+
+/*
+ * Free buffers per size class. Coroutines can resume on any io thread, so a buffer is often returned to another
+ * thread's lists than the one it was taken from. A thread's list is capped at a slab's worth of buffers, the excess
+ * goes to a shared depot that every thread refills from before mapping a new slab. Slabs are never unmapped, so the
+ * pools grow to the peak number of buffers in use plus at most a slab per thread and size class held locally.
+ */
+static thread_local std::array<std::vector<char*>, pool::SIZE_CLASSES.size()> free_lists;
+
+struct Depot {
+    std::mutex mutex;
+    std::vector<char*> buffers;
+};
+static std::array<Depot, pool::SIZE_CLASSES.size()> depots;
+
+static std::size_t local_cap(std::size_t size_class) {
+    return pool::SLAB_SIZE / pool::SIZE_CLASSES[size_class];
+}
+
+void pool::setHugePages(bool enabled) {
+    huge_pages.store(enabled, std::memory_order_relaxed);
+}
+
+static char* map_slab() {
+    if(!huge_pages.load(std::memory_order_relaxed)) {
+        void* slab = ::mmap(nullptr, pool::SLAB_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(slab == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        return static_cast<char*>(slab);
+    }
+
+    void* slab = ::mmap(nullptr, pool::SLAB_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if(slab != MAP_FAILED) {
+        return static_cast<char*>(slab);
+    }
+
+    // no reserved huge pages, map twice the size and trim to a huge page boundary so transparent huge pages can back it
+    void* region = ::mmap(nullptr, 2 * pool::SLAB_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(region == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    auto start = reinterpret_cast<std::uintptr_t>(region);
+    auto aligned = (start + pool::SLAB_SIZE - 1) & ~(pool::SLAB_SIZE - 1);
+    if(aligned > start) {
+        ::munmap(region, aligned - start);
+    }
+    if(std::size_t tail = start + 2 * pool::SLAB_SIZE - (aligned + pool::SLAB_SIZE)) {
+        ::munmap(reinterpret_cast<void*>(aligned + pool::SLAB_SIZE), tail);
+    }
+    ::madvise(reinterpret_cast<void*>(aligned), pool::SLAB_SIZE, MADV_HUGEPAGE);
+    return reinterpret_cast<char*>(aligned);
+}
+
+/* moves buffers in batches of half the cap, so a thread at the cap doesn't take the depot's lock on every release */
+static void refill(std::size_t size_class) {
+    auto& free_list = free_lists[size_class];
+    {
+        Depot& depot = depots[size_class];
+        std::lock_guard<std::mutex> lock(depot.mutex);
+        std::size_t take = std::min(depot.buffers.size(), local_cap(size_class) / 2);
+        free_list.insert(free_list.end(), depot.buffers.end() - take, depot.buffers.end());
+        depot.buffers.resize(depot.buffers.size() - take);
+    }
+    if(!free_list.empty()) {
+        return;
+    }
+
+    char* slab = map_slab();
+    std::size_t buffer_size = pool::SIZE_CLASSES[size_class];
+    for(std::size_t offset = 0; offset + buffer_size <= pool::SLAB_SIZE; offset += buffer_size) {
+        free_list.push_back(slab + offset);
+    }
+}
+
+pool::Lease pool::acquire(std::size_t size) {
+    for(std::size_t size_class = 0; size_class < SIZE_CLASSES.size(); ++size_class) {
+        if(size > SIZE_CLASSES[size_class]) {
+            continue;
+        }
+        auto& free_list = free_lists[size_class];
+        if(free_list.empty()) {
+            refill(size_class);
+        }
+        char* buffer = free_list.back();
+        free_list.pop_back();
+        return Lease(buffer, size, SIZE_CLASSES[size_class], size_class);
+    }
+    return Lease(new char[size], size, size, UNPOOLED);
+}
+
+pool::Lease::Lease(Lease&& other) noexcept
+: buffer(other.buffer), length(other.length), reserved(other.reserved), size_class(other.size_class) {
+    other.buffer = nullptr;
+}
+
+pool::Lease& pool::Lease::operator=(Lease&& other) noexcept {
+    if(this != &other) {
+        release();
+        buffer = other.buffer;
+        length = other.length;
+        reserved = other.reserved;
+        size_class = other.size_class;
+        other.buffer = nullptr;
+    }
+    return *this;
+}
+
+pool::Lease::~Lease() {
+    release();
+}
+
+void pool::Lease::release() {
+    if(!buffer) {
+        return;
+    }
+    if(size_class == UNPOOLED) {
+        delete[] buffer;
+    } else {
+        auto& free_list = free_lists[size_class];
+        free_list.push_back(buffer);
+        if(free_list.size() > local_cap(size_class)) {
+            std::size_t give = local_cap(size_class) / 2;
+            Depot& depot = depots[size_class];
+            std::lock_guard<std::mutex> lock(depot.mutex);
+            depot.buffers.insert(depot.buffers.end(), free_list.end() - give, free_list.end());
+            free_list.resize(free_list.size() - give);
+        }
+    }
+    buffer = nullptr;
+}
@@ -0,0 +1,56 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <span>
+
+namespace pool {
+
+    constexpr std::size_t SLAB_SIZE = 2 * 1024 * 1024; // one huge page, buffers are carved from slabs of this size
+    constexpr std::array<std::size_t, 3> SIZE_CLASSES = {8 * 1024, 16 * 1024, 256 * 1024}; // request reads, tls records, file and script chunks
+    constexpr std::size_t UNPOOLED = std::numeric_limits<std::size_t>::max();
+
+    /* Back new slabs with huge pages, falls back to regular pages if none are available. Set before the io threads start */
+    void setHugePages(bool enabled);
+
+    /*
+     * A buffer borrowed from the calling thread's pool, handed back to the pool of the thread that destroys it.
+     * The contents are not zeroed. size() starts at the requested size and can be shrunk or regrown up to capacity().
+     */
+    class Lease
+    {
+        public:
+        Lease() = default;
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&& other) noexcept;
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease();
+
+        char* data() {return buffer;}
+        const char* data() const {return buffer;}
+        std::size_t size() const {return length;}
+        std::size_t capacity() const {return reserved;}
+        void resize(std::size_t new_size) {length = new_size < reserved ? new_size : reserved;}
+        operator std::span<const char>() const {return {buffer, length};}
+
+        private:
+        friend Lease acquire(std::size_t size);
+        Lease(char* buffer, std::size_t length, std::size_t reserved, std::size_t size_class)
+        : buffer(buffer), length(length), reserved(reserved), size_class(size_class) {}
+        void release();
+
+        private:
+        char* buffer{nullptr};
+        std::size_t length{0};
+        std::size_t reserved{0};
+        std::size_t size_class{UNPOOLED};
+    };
+
+    /* Leases the smallest size class that fits, larger requests fall back to the heap */
+    Lease acquire(std::size_t size);
+};
+
+#endif
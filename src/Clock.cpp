@@ -0,0 +1,68 @@
+#include "Clock.h"
+#include "logger_macros.h"
+
+#include <chrono>
+
+using namespace clk;
+
+Clock Clock::INSTANCE;
+
+Clock* Clock::getInstance() {
+    return &Clock::INSTANCE;
+}
+
+const Snapshot* Clock::now() {
+    const Snapshot* snapshot = current.load(std::memory_order_acquire);
+    if(!ticking.load(std::memory_order_relaxed)) {
+        std::time_t seconds = std::time(nullptr);
+        if(!snapshot || snapshot->seconds != seconds) {
+            snapshot = refresh(seconds);
+        }
+    }
+    return snapshot;
+}
+
+const Snapshot* Clock::refresh() {
+    return refresh(std::time(nullptr));
+}
+
+const Snapshot* Clock::refresh(std::time_t seconds) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const Snapshot* published = current.load(std::memory_order_relaxed);
+    if(published && published->seconds == seconds) {
+        return published; // another thread got here first
+    }
+
+    Snapshot* snapshot = &snapshots[next];
+    next = (next + 1) % SNAPSHOT_COUNT;
+    snapshot->seconds = seconds;
+    std::tm tm;
+    gmtime_r(&seconds, &tm);
+    std::strftime(snapshot->http_date, sizeof(snapshot->http_date), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    localtime_r(&seconds, &tm);
+    std::strftime(snapshot->log_time, sizeof(snapshot->log_time), "%Y-%m-%d %H:%M", &tm);
+    current.store(snapshot, std::memory_order_release);
+    return snapshot;
+}
+
+/* wakes just after each second boundary so the published second matches the wall clock */
+asio::awaitable<void> Clock::tick() {
+    asio::steady_timer timer(co_await asio::this_coro::executor);
+    while(true) {
+        auto since_epoch = std::chrono::system_clock::now().time_since_epoch();
+        auto into_second = since_epoch - std::chrono::duration_cast<std::chrono::seconds>(since_epoch);
+        timer.expires_after(std::chrono::seconds(1) - into_second + std::chrono::milliseconds(1));
+        auto [ec] = co_await timer.async_wait(asio::as_tuple(asio::use_awaitable));
+        if(ec) {
+            co_return;
+        }
+        refresh();
+    }
+}
+
+void Clock::start(asio::io_context& io_context) {
+    refresh();
+    ticking.store(true, std::memory_order_relaxed);
+    asio::co_spawn(io_context, tick(), asio::detached);
+    TRACE("Clock", "clock started");
+}
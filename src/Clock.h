@@ -0,0 +1,53 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <asio.hpp>
+#include <asio/awaitable.hpp>
+#include <asio/steady_timer.hpp>
+#include <array>
+#include <atomic>
+#include <ctime>
+#include <mutex>
+
+namespace clk {
+
+    constexpr std::size_t SNAPSHOT_COUNT = 4; // a reader would have to hold a snapshot across 3 refreshes to see it rewritten
+
+    /* Wall clock time to the second, preformatted once for everyone that needs it */
+    struct Snapshot {
+        std::time_t seconds;
+        char http_date[32]; // RFC 7231 IMF-fixdate, e.g. "Sun, 06 Nov 1994 08:49:37 GMT"
+        char log_time[32]; // local "%Y-%m-%d %H:%M", the logger's timestamp format
+    };
+
+    /* 
+     * Publishes the current Snapshot through an atomic pointer, a read is one acquire load. Once started
+     * a timer refreshes it every second, until then (e.g. while the config loads) reads refresh on demand.
+     */
+    class Clock
+    {
+        public:
+        static Clock* getInstance();
+        void start(asio::io_context& io_context);
+        const Snapshot* now();
+        const Snapshot* refresh();
+
+        private:
+        static Clock INSTANCE;
+        std::atomic<const Snapshot*> current{nullptr};
+        std::atomic<bool> ticking{false};
+        std::mutex mutex; // serializes writers
+        std::array<Snapshot, SNAPSHOT_COUNT> snapshots{};
+        std::size_t next{0};
+
+        private:
+        Clock() = default;
+        Clock(const Clock&) = delete;
+        Clock& operator=(const Clock&) = delete;
+
+        const Snapshot* refresh(std::time_t seconds);
+        asio::awaitable<void> tick();
+    };
+};
+
+#endif
@@ -15,19 +15,20 @@ asio::awaitable<void> GetHandler::handleScript() {
             std::format("Failed to parse response from script"));
         }
 
-        response->body = http::extract_body(buffer);
-        response->addHeaders(http::extract_headers(buffer));
+        auto body = http::extract_body(buffer);
+        if(!body || !http::extract_headers(buffer, response->headers)) {
+            throw http::HTTPException(http::code::Bad_Gateway, 
+            std::format("Failed to parse response from script"));
+        }
         response->addHeader("Connection", "close");
-        std::string response_str = response->build();
-        std::span<const char> header_buf(response_str.data(), response_str.length());
-        http::io::WriteStatus result = co_await http::io::co_write_all(sock, header_buf);
+        http::io::WriteStatus result = co_await http::io::co_write_response(sock, response, *body);
         if(!http::is_success_code(result.status)) {
             throw http::HTTPException(result.status, std::move(result.message));
         }
         co_return;
     };
 
-    std::string script = request->endpoint->getResource(request->method);
+    std::string script = request->route->resource;
     std::string args(request->args);
     ScriptStreamer streamer(script, args, chunk_callback);
     co_await streamer.stream(txn->getSocket());
@@ -45,15 +46,12 @@ asio::awaitable<void> GetHandler::handleFile() {
     response->setStatus(http::code::OK);
     response->addHeader("Connection", "close");
     response->addHeader("Content-Type", content_type);
-    
-    std::string response_header = response->build();
-    StringStreamer s_stream(&response_header);
-    co_await s_stream.stream(txn->getSocket());
 
     FileStreamer f_stream(file);
-    response->addHeader("Content-Type", std::to_string(f_stream.getFileSize()));
+    response->addHeader("Content-Length", std::to_string(f_stream.getFileSize()));
+    f_stream.prepend(response->serializeHeaders());
     co_await f_stream.stream(txn->getSocket());
-    txn->addBytes(f_stream.getBytesStreamed() + s_stream.getBytesStreamed());
+    txn->addBytes(f_stream.getBytesStreamed());
     co_return;
 }
 
@@ -1,43 +1,29 @@
 #include "MethodHandler.h"
 #include "Session.h"
 
-void HeadHandler::buildResponse() {
-    std::string file = request->route->resource;
-    int filefd =  open(file.c_str(), O_RDONLY);
-    if(filefd == -1) {
-        throw http::HTTPException(http::code::Not_Found, 
-              std::format("failed to open file={}, for endpoint={}: errno={} ({})", file, request->endpoint_url, errno, strerror(errno)));
+#include <sys/stat.h>
+
+asio::awaitable<void> HeadHandler::handle() {    
+    if(!request->endpoint || !request->route || request->route->has_script) {
+        throw http::HTTPException(http::code::Service_Unavailable, 
+        std::format("No GET route found for endpoint={}", request->endpoint_url));
     }
-    
-    long file_len;
-    file_len = (long)lseek(filefd, (off_t)0, SEEK_END);
-    if(file_len <= 0) {
+
+    std::string file = request->route->resource;
+    struct stat file_stat;
+    if(stat(file.c_str(), &file_stat) != 0 || file_stat.st_size <= 0) {
         throw http::HTTPException(http::code::Not_Found, 
-              std::format("failed to open file={}, for endpoint={}: errno={} ({})", file, request->endpoint_url, errno, strerror(errno)));
+              std::format("failed to stat file={}, for endpoint={}: errno={} ({})", file, request->endpoint_url, errno, strerror(errno)));
     }
-    lseek(filefd, 0, SEEK_SET);
-    close(filefd);
-
-    std::string content_type;
-    if(http::determine_content_type(request->endpoint->getResource(request->method), content_type) != http::code::OK) {
+    if(request->route->canned_head.empty()) { // the content type couldn't be determined when the route was added
         throw http::HTTPException(http::code::Forbidden, std::format("failed to extract content type for endpoint={}, from file={}", request->endpoint_url, file));
     }
 
-    response->setStatus(http::code::OK);
-    response->addHeader("Connection", "close");
-    response->addHeader("Content-Type", content_type);
-    response->addHeader("Content-Length", std::to_string(file_len));
-}
-
-asio::awaitable<void> HeadHandler::handle() {    
-    if(!request->endpoint || !request->route || request->route->has_script) {
-        throw http::HTTPException(http::code::Service_Unavailable, 
-        std::format("No GET route found for endpoint={}", request->endpoint_url));
+    response->addHeader("Content-Length", std::to_string(file_stat.st_size));
+    http::io::WriteStatus result = co_await http::io::co_write_canned(txn->getSocket(), response, request->route->canned_head, "");
+    if(!http::is_success_code(result.status)) {
+        throw http::HTTPException(result.status, std::move(result.message));
     }
-    buildResponse();
-    std::string response_header = txn->getResponse()->build();
-    StringStreamer stream(&response_header);
-    co_await stream.stream(txn->getSocket());
-    txn->addBytes(stream.getBytesStreamed());
+    txn->addBytes(result.bytes);
     co_return;
 }
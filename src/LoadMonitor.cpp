@@ -0,0 +1,63 @@
+#include "LoadMonitor.h"
+
+LoadMonitor LoadMonitor::INSTANCE;
+
+LoadMonitor* LoadMonitor::getInstance() {
+    return &LoadMonitor::INSTANCE;
+}
+
+void LoadMonitor::start(asio::io_context& io_context, std::size_t samplers, const cfg::LoadSheddingConfig* setting) {
+    this->setting = setting;
+    for(std::size_t i = 0; i < samplers; ++i) {
+        asio::co_spawn(io_context, sample(), asio::detached);
+    }
+    DEBUG("Load Monitor", "started %zu lag samplers, interval=%dms", samplers, setting->sample_interval_ms);
+}
+
+/* returns true if the state changed, enters above the threshold and leaves below half of it to avoid flapping */
+bool LoadMonitor::updateState(std::atomic<bool>& state, std::int64_t lag_us, int threshold_ms) {
+    std::int64_t threshold_us = static_cast<std::int64_t>(threshold_ms) * 1000;
+    bool active = state.load(std::memory_order_relaxed);
+    if(!active && lag_us > threshold_us) {
+        return !state.exchange(true, std::memory_order_relaxed);
+    } 
+    if(active && lag_us < threshold_us / 2) {
+        return state.exchange(false, std::memory_order_relaxed);
+    }
+    return false;
+}
+
+void LoadMonitor::record(std::chrono::steady_clock::duration lag) {
+    std::int64_t sample_us = std::chrono::duration_cast<std::chrono::microseconds>(lag).count();
+    std::int64_t old = lag_us.load(std::memory_order_relaxed);
+    std::int64_t desired;
+    do {
+        desired = old + (sample_us - old) / 4; // EWMA, alpha=1/4
+    } while(!lag_us.compare_exchange_weak(old, desired, std::memory_order_relaxed));
+
+    if(updateState(shed_scripts, desired, setting->shed_scripts_lag_ms)) {
+        WARN("Load Monitor", "io lag=%ldus, %s script requests", static_cast<long>(desired), shed_scripts.load() ? "shedding" : "resumed");
+    }
+    if(updateState(pause_accept, desired, setting->stop_accept_lag_ms)) {
+        WARN("Load Monitor", "io lag=%ldus, %s accepting connections", static_cast<long>(desired), pause_accept.load() ? "paused" : "resumed");
+    }
+}
+
+asio::awaitable<void> LoadMonitor::sample() {
+    auto interval = std::chrono::milliseconds(setting->sample_interval_ms);
+    asio::steady_timer timer(co_await asio::this_coro::executor);
+    auto expected = std::chrono::steady_clock::now() + interval;
+    while(true) {
+        timer.expires_at(expected);
+        auto [ec] = co_await timer.async_wait(asio::as_tuple(asio::use_awaitable));
+        if(ec) {
+            co_return;
+        }
+        auto now = std::chrono::steady_clock::now();
+        record(now - expected);
+        expected += interval;
+        if(expected < now) {
+            expected = now + interval; // don't fire a burst of late samples after a stall
+        }
+    }
+}
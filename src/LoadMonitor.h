@@ -0,0 +1,44 @@
+#ifndef LOADMONITOR_H
+#define LOADMONITOR_H
+
+#include <asio.hpp>
+#include <asio/awaitable.hpp>
+#include <asio/steady_timer.hpp>
+#include <atomic>
+#include <chrono>
+
+#include "config.h"
+
+/* 
+ * Samples io_context scheduling lag, the delay between a timer's expected and actual wakeup. 
+ * The samplers share the io_context's queue with all other work and aren't pinned to threads, so they measure the
+ * queueing delay of the context as a whole. Running one per io thread only adds samples per interval.
+ */
+class LoadMonitor
+{
+    public:
+    static LoadMonitor* getInstance();
+    void start(asio::io_context& io_context, std::size_t samplers, const cfg::LoadSheddingConfig* setting);
+
+    std::chrono::microseconds getLag() const {return std::chrono::microseconds(lag_us.load(std::memory_order_relaxed));}
+    bool shouldShedScripts() const {return shed_scripts.load(std::memory_order_relaxed);}
+    bool shouldPauseAccept() const {return pause_accept.load(std::memory_order_relaxed);}
+
+    private:
+    static LoadMonitor INSTANCE;
+    const cfg::LoadSheddingConfig* setting{nullptr};
+    std::atomic<std::int64_t> lag_us{0}; // EWMA over all samplers
+    std::atomic<bool> shed_scripts{false};
+    std::atomic<bool> pause_accept{false};
+
+    private:
+    LoadMonitor() {}
+    LoadMonitor(const LoadMonitor&) = delete;
+    LoadMonitor& operator=(const LoadMonitor&) = delete;
+
+    asio::awaitable<void> sample();
+    void record(std::chrono::steady_clock::duration lag);
+    static bool updateState(std::atomic<bool>& state, std::int64_t lag_us, int threshold_ms);
+};
+
+#endif
@@ -0,0 +1,21 @@
+#include "MethodHandler.h"
+
+asio::awaitable<void> LogLevelHandler::handle() {
+    http::json body = parseJSONBody("log level");
+
+    if(!body.contains("level") || !body["level"].is_string()) {
+        throw http::HTTPException(http::code::Bad_Request, std::format("log level request from client={} is missing a level", sock->getIP()));
+    }
+    std::string level = body["level"];
+    std::transform(level.begin(), level.end(), level.begin(), [](unsigned char c){ return static_cast<char>(std::tolower(c)); });
+    logger::level threshold = logger::level_str_to_enum(level, logger::level::Status);
+    if(threshold == logger::level::Status) {
+        throw http::HTTPException(http::code::Bad_Request, std::format("log level request from client={} has an unknown level={}", sock->getIP(), level));
+    }
+
+    logger::Logger::getInstance()->setThreshold(threshold);
+    STATUS("Log Level Handler", "log level set to %s by client=%s", logger::level_to_str(threshold).c_str(), sock->getIP().c_str());
+
+    http::json reply = {{"level", logger::level_to_str(threshold)}};
+    co_await sendJSON(reply);
+}
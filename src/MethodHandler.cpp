@@ -0,0 +1,24 @@
+#include "MethodHandler.h"
+
+http::json MethodHandler::parseJSONBody(std::string_view request_name) {
+    http::json body;
+    http::code status;
+    if((status = http::build_json(*txn->getBuffer(), body)) != http::code::OK) {
+        throw http::HTTPException(status == http::code::Not_Implemented ? http::code::Unsupported_Media_Type : status, 
+        std::format("{} request from client={} has an unsupported body", request_name, sock->getIP()));
+    }
+    return body;
+}
+
+asio::awaitable<void> MethodHandler::sendJSON(const http::json& reply) {
+    response->setStatus(http::code::OK);
+    response->body = reply.dump();
+    response->addHeader("Content-Type", "application/json");
+    response->addHeader("Content-Length", std::to_string(response->body.length()));
+    response->addHeader("Connection", "close");
+    http::io::WriteStatus result = co_await http::io::co_write_response(sock, response);
+    if(!http::is_success_code(result.status)) {
+        throw http::HTTPException(result.status, std::move(result.message));
+    }
+    txn->addBytes(result.bytes);
+}
@@ -30,6 +30,10 @@ class MethodHandler : public std::enable_shared_from_this<MethodHandler>
 
     virtual asio::awaitable<void> handle() = 0;
 
+    protected:
+    http::json parseJSONBody(std::string_view request_name); // throws 415 or 400 if the body isn't json
+    asio::awaitable<void> sendJSON(const http::json& reply); // a 200 with the reply as the body
+
     protected:
     Transaction* txn;
     Socket* sock;
@@ -56,11 +60,6 @@ class HeadHandler: public MethodHandler
     HeadHandler(Transaction* txn): MethodHandler(txn) {};
     
     asio::awaitable<void> handle() override;
-
-    private:
-    void buildResponse();
-
-    private:
 };
 
 class PostHandler: public MethodHandler 
@@ -83,4 +82,22 @@ class OptionsHandler: public MethodHandler
     asio::awaitable<void> handle() override;
 };
 
+/* Admin endpoint, revokes the jti or raw token in the request body until its expiry */
+class RevokeHandler: public MethodHandler
+{
+    public:
+    RevokeHandler(Transaction* txn): MethodHandler(txn) {};
+
+    asio::awaitable<void> handle() override;
+};
+
+/* Admin endpoint, sets the logger's runtime threshold from the request body */
+class LogLevelHandler: public MethodHandler
+{
+    public:
+    LogLevelHandler(Transaction* txn): MethodHandler(txn) {};
+
+    asio::awaitable<void> handle() override;
+};
+
 #endif
\ No newline at end of file
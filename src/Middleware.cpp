@@ -1,32 +1,110 @@
 #include "Middleware.h"
 #include "Session.h"
-#include <jwt-cpp/traits/nlohmann-json/defaults.h>
+#include "LoadMonitor.h"
+#include "Revocation.h"
+#include "TimerWheel.h"
+
+#include <asio/experimental/awaitable_operators.hpp>
+#include <exception>
+#include <sys/socket.h>
 
 using namespace mw;
+using namespace asio::experimental::awaitable_operators;
+
+/*
+ * Completes once the client hangs up, else runs until cancelled. Sessions close after one response, so nothing the
+ * client sends past the request is served.
+ * A plain connection is peeked once readable, a reset means the client is gone. Pipelined bytes or a half close leave
+ * it waiting on the response, the watch parks until the handler finishes.
+ * Peeking a tls connection sees only records, and 1.3 encrypts the close_notify alert like any data, so it's read
+ * through the stream instead. A close_notify or a failed read means the client is gone, data read is dropped.
+ */
+static asio::awaitable<void> watch_disconnect(Socket* sock) {
+    if(sock->isTLS()) {
+        char discard[512];
+        while(true) {
+            auto [ec, bytes] = co_await sock->co_read(discard, sizeof(discard));
+            if(ec) {
+                co_return;
+            }
+        }
+    }
 
-static asio::awaitable<void> run_pipeline(Transaction *txn, std::size_t index, std::vector<std::unique_ptr<Middleware>>* pipeline) {
-    if (index >= pipeline->size()) {
+    auto& raw = sock->getRawSocket();
+    while(true) {
+        auto [ec] = co_await raw.async_wait(asio::ip::tcp::socket::wait_read, asio::as_tuple(asio::use_awaitable));
+        if(ec == asio::error::operation_aborted) {
+            co_return;
+        }
+
+        char byte;
+        ssize_t peeked = ec ? 1 : ::recv(raw.native_handle(), &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+        if(peeked < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            co_return;
+        }
+        if(peeked < 0) {
+            continue;
+        }
+
+        // still connected, half closed, or unable to tell, park until the handler finishes and cancels the watch
+        asio::steady_timer parked(co_await asio::this_coro::executor, asio::steady_timer::time_point::max());
+        co_await parked.async_wait(asio::as_tuple(asio::use_awaitable));
         co_return;
     }
+}
+
+/* 
+ * Runs the handler with any failure handed back instead of thrown. The || race only ends early on success, a handler
+ * that threw would otherwise leave it waiting on the watcher until the client goes away or times out.
+ */
+static asio::awaitable<std::exception_ptr> run_caught(const http::Handler& handler, Transaction* txn) {
+    try {
+        co_await handler(txn);
+    } catch (...) {
+        co_return std::current_exception();
+    }
+    co_return nullptr;
+}
+
+static asio::awaitable<http::Result<>> run_pipeline(Transaction *txn, std::size_t index, std::vector<std::unique_ptr<Middleware>>* pipeline) {
+    if (index >= pipeline->size()) {
+        co_return http::Result<>{};
+    }
 
     mw::Middleware *mw = (*pipeline)[index].get();
-    mw::Next next_func = [pipeline, txn, index]() -> asio::awaitable<void> {
-        co_await run_pipeline(txn, index + 1, pipeline);
+    mw::Next next_func = [pipeline, txn, index]() -> asio::awaitable<http::Result<>> {
+        co_return co_await run_pipeline(txn, index + 1, pipeline);
     };
-    co_await mw->process(txn, next_func);
+    co_return co_await mw->process(txn, next_func);
 }
 
 asio::awaitable<void> Pipeline::run(Transaction* txn) {
-    co_return co_await run_pipeline(txn, 0, &components);
+    co_await run_pipeline(txn, 0, &components); // the error handler has already answered any error
 }
 
-asio::awaitable<void> mw::ErrorHandler::process(Transaction* txn, Next next) {
+asio::awaitable<http::Result<>> mw::ErrorHandler::process(Transaction* txn, Next next) {
     http::Handler error_handler = nullptr;
     try {
-        co_await next();
-        auto request = txn->getRequest();
-        if(auto finisher = request->endpoint->getHandler(request->method)) {
-            co_await finisher(txn);
+        http::Result<> result = co_await next();
+        if(result) {
+            auto route = txn->getRequest()->route;
+            if(route->handler && route->has_script) {
+                // a script keeps running and the client's permits stay held until it's done, stop it if nobody is listening
+                auto outcome = co_await (run_caught(route->handler, txn) || watch_disconnect(txn->getSocket()));
+                if(outcome.index() == 1) {
+                    timer::Deadline* deadline = txn->getSocket()->getDeadline();
+                    txn->response.setStatus(deadline && deadline->expired() ? http::code::Request_Timeout : http::code::Client_Closed_Request);
+                    DEBUG("MW Error Handler", "client=%s went away, cancelled script=%s", txn->getSocket()->getIP().c_str(), route->resource.c_str());
+                } else if(std::exception_ptr error = std::get<0>(outcome)) {
+                    std::rethrow_exception(error); // handled below like any other handler failure
+                }
+            } else if(route->handler) {
+                co_await route->handler(txn);
+            }
+        } else {
+            DEBUG("MW Error Handler", "status=%d %s", static_cast<int>(result.error().status), result.error().message.c_str());
+            txn->response = http::Response(std::move(result.error()));
+            error_handler = http::Router::getInstance()->getErrorPage(txn->response.getStatus())->handler;
         }
     }
     catch (const http::HTTPException& http_error) {
@@ -44,122 +122,256 @@ asio::awaitable<void> mw::ErrorHandler::process(Transaction* txn, Next next) {
         TRACE("MW Error Handler", "Serving error page for status=%d", static_cast<int>(txn->response.getStatus()));
         co_await error_handler(txn);
     }
-    co_return;
+    txn->releasePermits();
+    co_return http::Result<>{};
 }
 
-asio::awaitable<void> mw::Parser::process(Transaction* txn, Next next) {
+asio::awaitable<http::Result<>> mw::Parser::process(Transaction* txn, Next next) {
     auto buffer =  txn->getBuffer();
+    timer::Deadline* deadline = txn->getSocket()->getDeadline();
+    if(deadline) {
+        deadline->arm(timer::phase::Read);
+    }
     auto [ec, bytes] = co_await txn->getSocket()->co_read(buffer->data(), buffer->size());
     txn->getLogEntry()->Latency_end_time = std::chrono::system_clock::now();
     buffer->resize(bytes);
 
+    if(deadline && deadline->expired()) {
+        co_return http::Error{http::code::Request_Timeout, std::format("timed out reading request from client: {}", txn->sock->getIP())};
+    }
+    if(deadline) {
+        deadline->disarm();
+    }
     if(ec) {
-        throw (ec.value() == asio::error::connection_reset || ec.value() == asio::error::broken_pipe || ec.value() == asio::error::eof) ?
-                http::HTTPException(http::code::Client_Closed_Request, std::format("Failed to read request from client: {}", txn->sock->getIP())) :
-                http::HTTPException(http::code::Internal_Server_Error, std::format("Failed to read request from client: {}", txn->sock->getIP()));
+        co_return http::Error{http::io::is_client_disconnect(ec) ? http::code::Client_Closed_Request : http::code::Internal_Server_Error, 
+                              std::format("Failed to read request from client: {}", txn->sock->getIP())};
     }
 
     auto router = http::Router::getInstance();
-    http::Request request;
-    request.endpoint_url = http::extract_endpoint(*buffer);
-    request.endpoint = router->getEndpoint(request.endpoint_url);
-    request.method = http::extract_method(*buffer);
-    request.args = http::extract_args(*buffer, request.endpoint->getArgType(request.method));
-    request.headers = http::extract_headers(*buffer);
-    request.body = http::extract_body(*buffer);
-    request.query = http::extract_query_string(*buffer);
-    request.route = router->getEndpointMethod(request.endpoint_url, request.method);
+    http::Request request(txn->getAllocator());
+    auto endpoint_url = http::extract_endpoint(*buffer);
+    if(!endpoint_url) {
+        co_return std::move(endpoint_url.error());
+    }
+    request.endpoint_url = std::move(*endpoint_url);
+    auto endpoint = router->getEndpoint(request.endpoint_url);
+    if(!endpoint) {
+        co_return std::move(endpoint.error());
+    }
+    request.endpoint = *endpoint;
+    auto method = http::extract_method(*buffer);
+    if(!method) {
+        co_return std::move(method.error());
+    }
+    request.method = *method;
+    auto route = request.endpoint->getMethod(request.method);
+    if(!route) {
+        co_return std::move(route.error());
+    }
+    request.route = *route;
+    auto args = http::extract_args(*buffer, request.route->args);
+    if(!args) {
+        co_return std::move(args.error());
+    }
+    request.args = *args;
+    if(auto headers = http::extract_headers(*buffer, request.headers); !headers) {
+        co_return std::move(headers.error());
+    }
+    auto body = http::extract_body(*buffer);
+    if(!body) {
+        co_return std::move(body.error());
+    }
+    request.body = *body;
+    auto query = http::extract_query_string(*buffer);
+    if(!query) {
+        co_return std::move(query.error());
+    }
+    request.query = *query;
 
     TRACE("MW Parser", "Hit for endpoint: %s", request.endpoint_url.c_str());
 
     txn->setRequest(std::move(request));
-    co_await next();
+    co_return co_await next();
 }
 
-asio::awaitable<void> mw::Logger::process(Transaction* txn, Next next) {
+/* true with probability 1/n, the generator is per thread so sampling never touches shared state */
+static bool sample(std::uint32_t n) {
+    thread_local std::uint64_t state = std::hash<std::thread::id>{}(std::this_thread::get_id()) | 1;
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state % n == 0;
+}
+
+asio::awaitable<http::Result<>> mw::Logger::process(Transaction* txn, Next next) {
     logger::SessionEntry* entry = txn->getLogEntry();
     entry->Latency_start_time = std::chrono::system_clock::now();
     entry->RTT_start_time = std::chrono::system_clock::now();
     entry->client_addr = txn->getSocket()->getIP();
     
-    co_await next();
+    http::Result<> result = co_await next();
+
+    bool success = http::is_success_code(txn->getResponse()->status);
+    const http::EndpointMethod* route = txn->getRequest()->route;
+    if(success && route && route->log_sample > 1 && !sample(route->log_sample)) {
+        co_return result;
+    }
 
-    const std::vector<char>* buffer = txn->getBuffer();
+    const pool::Lease* buffer = txn->getBuffer();
     entry->user_agent = logger::get_user_agent(buffer->data(), buffer->size());
     entry->request = logger::get_header_line(buffer->data(), buffer->size());
     entry->response = txn->getResponse()->status_msg;
     entry->RTT_end_time = std::chrono::system_clock::now();
-    entry->level = http::is_success_code(txn->getResponse()->status) ? logger::level::Info : logger::level::Error;
+    entry->level = success ? logger::level::Info : logger::level::Error;
     LOG_SESSION(std::move(txn->log_entry));
+    co_return result;
 }
 
 namespace {
 }
 
-void mw::Authenticator::validate(Transaction* txn, const http::EndpointMethod* route) {
+asio::awaitable<http::Result<>> mw::LoadShedder::process(Transaction* txn, Next next) {
     auto request = txn->getRequest();
+    auto monitor = LoadMonitor::getInstance();
+    if(request->route->has_script && monitor->shouldShedScripts()) {
+        co_return http::Error{http::code::Service_Unavailable, 
+            std::format("shed [{} {}] for client={}: io lag={}us", http::method_enum_to_str(request->method), request->endpoint_url, 
+            txn->getSocket()->getIP(), monitor->getLag().count()), {{"Retry-After", "1"}}};
+    }
+    co_return co_await next();
+}
 
-    if(!route->is_protected) {
-        return;
+bool TokenCache::find(const std::string& token, std::uint64_t generation, const cfg::Role*& role) {
+    std::size_t hash = std::hash<std::string>{}(token);
+    Shard& shard = shards[hash % SHARD_COUNT];
+    std::lock_guard lock(shard.mutex);
+    auto it = shard.entries.find(hash);
+    if(it == shard.entries.end() || it->second.token != token) {
+        return false;
+    }
+    if(it->second.generation != generation || std::chrono::system_clock::now() > it->second.expires_at) {
+        shard.entries.erase(it);
+        return false;
     }
+    role = it->second.role;
+    return true;
+}
 
-    std::string cookie, token;
-    if ((cookie = request->getHeader("Cookie")).empty() || (token = http::extract_jwt_from_cookie(cookie)).empty()) {
-        throw http::HTTPException(http::code::Unauthorized, "missing or invalid authentication token");
+void TokenCache::insert(const std::string& token, const cfg::Role* role, std::chrono::system_clock::time_point expires_at, std::uint64_t generation) {
+    auto now = std::chrono::system_clock::now();
+    expires_at = std::min(expires_at, now + MAX_TTL);
+    std::size_t hash = std::hash<std::string>{}(token);
+    Shard& shard = shards[hash % SHARD_COUNT];
+
+    std::lock_guard lock(shard.mutex);
+    if(shard.entries.size() >= SHARD_CAPACITY) {
+        std::erase_if(shard.entries, [now](const auto& entry) { return now > entry.second.expires_at; });
     }
+    if(shard.entries.size() >= SHARD_CAPACITY) {
+        shard.entries.erase(shard.entries.begin()); // still full of live tokens, evict an arbitrary one
+    }
+    shard.entries[hash] = VerifiedToken{token, role, expires_at, generation};
+}
 
-    try {
+mw::Authenticator::Authenticator()
+    : signer(config->getSecret()),
+      verifier(jwt::verify().allow_algorithm(jwt::algorithm::hs256{config->getSecret()}).with_issuer(config->getServerName()))
+{}
+
+/* returns the role named by the verified claim, the signature, revocation and role lookup only happen on a cache miss */
+http::Result<const cfg::Role*> mw::Authenticator::verify(Transaction* txn, const std::string& token) {
+    RevocationList* revoked = RevocationList::getInstance();
+    std::uint64_t generation = revoked->getGeneration(); // read before checking, a concurrent revocation leaves a stale entry
+    const cfg::Role* role;
+    if(token_cache.find(token, generation, role)) {
+        return role;
+    }
+
+    const char* rejected = nullptr;
+    try { // jwt-cpp reports malformed and forged tokens by throwing
         auto decoded_token = jwt::decode(token);
-        auto verifier = jwt::verify().allow_algorithm(jwt::algorithm::hs256{config->getSecret()}).with_issuer(config->getServerName());
         verifier.verify(decoded_token);
 
-        if(decoded_token.has_expires_at() && std::chrono::system_clock::now() > decoded_token.get_expires_at()) {
-            throw http::HTTPException(http::code::Unauthorized, "expired token");
+        auto expires_at = std::chrono::system_clock::time_point::max();
+        if(decoded_token.has_expires_at()) {
+            expires_at = decoded_token.get_expires_at();
+            if(std::chrono::system_clock::now() > expires_at) {
+                rejected = "expired token";
+            }
+        }
+
+        if(!rejected && ((decoded_token.has_id() && revoked->isRevoked(decoded_token.get_id())) || revoked->isRevoked(token_digest(token)))) {
+            rejected = "revoked token";
         }
 
-        auto role_claim = decoded_token.get_payload_claim("role");
-        const cfg::Role* role;
-        if(!((role = config->findRole(role_claim.as_string())) && role->includesRole(route->access_role))) {
-            throw http::HTTPException(http::code::Unauthorized, "insufficient permissions");
+        if(!rejected) {
+            role = config->findRole(decoded_token.get_payload_claim("role").as_string());
+            token_cache.insert(token, role, expires_at, generation);
+            return role;
         }
     } catch (const std::exception& error) {
-        throw http::HTTPException(http::code::Unauthorized,
-        std::format("[client {}] invalid token [error {}]", txn->getSocket()->getIP(), error.what()));
+        return http::Error{http::code::Unauthorized,
+        std::format("[client {}] invalid token [error {}]", txn->getSocket()->getIP(), error.what())};
     }
+    return http::Error{http::code::Unauthorized, std::format("[client {}] invalid token [error {}]", txn->getSocket()->getIP(), rejected)};
 }
 
-asio::awaitable<void> mw::Authenticator::process(Transaction* txn, Next next) {
+http::Result<> mw::Authenticator::validate(Transaction* txn, const http::EndpointMethod* route) {
+    auto request = txn->getRequest();
+
+    if(!route->is_protected) {
+        return {};
+    }
+
+    std::string cookie, token;
+    if ((cookie = request->getHeader("Cookie")).empty() || (token = http::extract_jwt_from_cookie(cookie)).empty()) {
+        return http::Error{http::code::Unauthorized, "missing or invalid authentication token"};
+    }
+
+    auto role = verify(txn, token);
+    if(!role) {
+        return std::move(role.error());
+    }
+    if(!*role || !(*role)->includesRole(route->access_role_id)) {
+        return http::Error{http::code::Unauthorized,
+        std::format("[client {}] invalid token [error insufficient permissions]", txn->getSocket()->getIP())};
+    }
+    return {};
+}
+
+asio::awaitable<http::Result<>> mw::Authenticator::process(Transaction* txn, Next next) {
     auto request = txn->getRequest();
     const cfg::Config* config = cfg::Config::getInstance();
 
-    validate(txn, request->route);
-    co_await next();
+    http::Result<> result = validate(txn, request->route);
+    if(!result) {
+        co_return result;
+    }
+    result = co_await next();
 
-     if(!request->route->is_authenticator) {
-        co_return;
+     if(!result || !request->route->is_authenticator) {
+        co_return result;
     }
 
     auto response = txn->getResponse();
     if(!http::is_success_code(response->status)) {
-        throw http::HTTPException(response->status, std::format("Failed to authorize client: {} [status={}]", txn->getSocket()->getIP(), static_cast<int>(response->status)));
+        co_return http::Error{response->status, std::format("Failed to authorize client: {} [status={}]", txn->getSocket()->getIP(), static_cast<int>(response->status))};
     }
 
     auto token_builder = jwt::create();
-    std::string token = token_builder.set_issuer(config->getServerName()).set_subject("auth-token").set_expires_at(DEFAULT_EXPIRATION)
-                        .set_payload_claim("role", jwt::claim(cfg::get_role_hash(request->endpoint->getAuthRole(request->method)))).sign(jwt::algorithm::hs256{config->getSecret()});
+    std::string token = token_builder.set_issuer(config->getServerName()).set_subject("auth-token").set_id(generate_token_id()).set_expires_at(DEFAULT_EXPIRATION)
+                        .set_payload_claim("role", jwt::claim(cfg::get_role_hash(request->route->auth_role))).sign(signer);
     response->addHeader("Set-Cookie", std::format("jwt={}; HttpOnly; Secure; SameSite=Strict;", token));
-    co_return;
+    co_return result;
 }
 
 
-asio::awaitable<void> RateLimiter::process(Transaction* txn, Next next) {
+asio::awaitable<http::Result<>> RateLimiter::process(Transaction* txn, Next next) {
     auto limiter = txn->getRequest()->route->rate_limiter.get();
     if(limiter) {
-        co_await limiter->process(txn, next);
-    } else {
-        co_await next();
+        co_return co_await limiter->process(txn, next);
     }
-    co_return;
+    co_return co_await next();
 }
 
 IpInfo* FixedWindowLimiter::findClient(const std::string& ip) {
@@ -179,7 +391,7 @@ IpInfo* FixedWindowLimiter::findClient(const std::string& ip) {
     return client_raw;
 }
 
-asio::awaitable<void> mw::FixedWindowLimiter::process(Transaction* txn, Next next) {
+asio::awaitable<http::Result<>> mw::FixedWindowLimiter::process(Transaction* txn, Next next) {
     std::string key = setting.make_key(txn);
     auto client_info = findClient(key);
 
@@ -199,8 +411,8 @@ asio::awaitable<void> mw::FixedWindowLimiter::process(Transaction* txn, Next nex
                 uint32_t reset_time   = window_start + setting.window_seconds;
                 uint32_t retry_after  = (reset_time > secs) ? (reset_time - secs) : 0;
                 headers["Retry-After"] = std::to_string(retry_after);
-                throw http::HTTPException(http::code::Too_Many_Requests, 
-                std::format("client={} has exceeded {} requests in {}s", key, setting.max_requests, setting.window_seconds), std::move(headers));
+                co_return http::Error{http::code::Too_Many_Requests, 
+                std::format("client={} has exceeded {} requests in {}s", key, setting.max_requests, setting.window_seconds), std::move(headers)};
             } 
             desired = (std::uint64_t(this_window_id) << 32) | (old_count + 1); // increment by 1
         } else {
@@ -217,9 +429,9 @@ asio::awaitable<void> mw::FixedWindowLimiter::process(Transaction* txn, Next nex
     resp->addHeader("X-RateLimit-Reset",     std::to_string(reset_time));
 
     if(next) {
-        co_await next();
+        co_return co_await next();
     }
-    co_return;
+    co_return http::Result<>{};
 }
 
 Bucket* mw::TokenBucketLimiter::findBucket(const std::string& key) {
@@ -246,7 +458,7 @@ Bucket* mw::TokenBucketLimiter::findBucket(const std::string& key) {
     return raw;
 }
 
-asio::awaitable<void> mw::TokenBucketLimiter::process(Transaction* txn, Next next) {
+asio::awaitable<http::Result<>> mw::TokenBucketLimiter::process(Transaction* txn, Next next) {
     std::string key = setting.make_key(txn);
     auto bucket = findBucket(key);
 
@@ -271,10 +483,10 @@ asio::awaitable<void> mw::TokenBucketLimiter::process(Transaction* txn, Next nex
             std::unordered_map<std::string, std::string> headers;
             std::uint32_t retry_after = new_refill + 1 > secs ? (new_refill + 1 - secs) : 0;
             headers["Retry-After"] = std::to_string(retry_after); 
-            throw http::HTTPException(http::code::Too_Many_Requests, 
+            co_return http::Error{http::code::Too_Many_Requests, 
                 std::format("client={} has exceeded rate limit on [{} {}] ({} tokens/s cap={} tokens)", 
                 txn->getSocket()->getIP(), http::method_enum_to_str(txn->getRequest()->method), 
-                txn->getRequest()->endpoint_url, setting.refill_rate, setting.capacity), std::move(headers));
+                txn->getRequest()->endpoint_url, setting.refill_rate, setting.capacity), std::move(headers)};
         }
 
         updated_tokens = std::uint32_t(new_tokens - 1);
@@ -293,9 +505,137 @@ asio::awaitable<void> mw::TokenBucketLimiter::process(Transaction* txn, Next nex
     response->addHeader("Retry-After", std::to_string(delay));
 
     if(next) {
-        co_await next();
+        co_return co_await next();
+    }
+    co_return http::Result<>{};
+}
+
+asio::awaitable<http::Result<>> Bulkhead::process(Transaction* txn, Next next) {
+    auto limiter = txn->getRequest()->route->concurrency_limiter.get();
+    if(limiter) {
+        co_return co_await limiter->process(txn, next);
+    }
+    co_return co_await next();
+}
+
+mw::Permit::~Permit() {
+    limiter->release(std::chrono::steady_clock::now() - start, txn->getResponse()->getStatus() >= http::code::Internal_Server_Error);
+}
+
+bool mw::ConcurrencyLimiter::tryAcquire() {
+    int current = in_flight.load(std::memory_order_relaxed);
+    while(current < limit.load(std::memory_order_relaxed)) {
+        if(in_flight.compare_exchange_weak(current, current + 1, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* caller must hold waiters_mutex, slots are handed to the oldest waiters first */
+void mw::ConcurrencyLimiter::grantWaiters() {
+    while(!waiters.empty() && tryAcquire()) {
+        auto waiter = std::move(waiters.front());
+        waiters.pop_front();
+        queued.fetch_sub(1);
+        waiter->timer.cancel();
+        waiter->notify({});
     }
-    co_return;
 }
 
- 
\ No newline at end of file
+asio::awaitable<asio::error_code> mw::ConcurrencyLimiter::enqueue() {
+    auto waiter = std::make_shared<Waiter>(co_await asio::this_coro::executor);
+    auto token = asio::as_tuple(asio::use_awaitable);
+    auto [ec] = co_await asio::async_initiate<decltype(token), void(asio::error_code)>(
+        [this, waiter](auto handler) {
+            auto shared_handler = std::make_shared<decltype(handler)>(std::move(handler));
+            waiter->complete = [shared_handler](asio::error_code ec) {
+                auto executor = asio::get_associated_executor(*shared_handler);
+                asio::post(executor, [shared_handler, ec]() { std::move(*shared_handler)(ec); });
+            };
+
+            std::lock_guard lock(waiters_mutex);
+            if(waiters.size() >= static_cast<std::size_t>(setting.queue_size)) {
+                waiter->notify(asio::error::no_buffer_space);
+                return;
+            }
+            waiters.push_back(waiter);
+            queued.fetch_add(1);
+            grantWaiters(); // a slot may have been released before we were queued
+            if(!waiter->complete) {
+                return;
+            }
+
+            waiter->timer.expires_after(std::chrono::milliseconds(setting.queue_timeout_ms));
+            waiter->timer.async_wait([this, waiter](const asio::error_code&) {
+                std::lock_guard lock(waiters_mutex);
+                auto it = std::find(waiters.begin(), waiters.end(), waiter);
+                if(it == waiters.end()) {
+                    return; // already granted a slot
+                }
+                waiters.erase(it);
+                queued.fetch_sub(1);
+                waiter->notify(asio::error::timed_out);
+            });
+        }, token);
+    co_return ec;
+}
+
+void mw::ConcurrencyLimiter::adapt(std::chrono::steady_clock::duration latency, bool failed) {
+    if(setting.algorithm != cfg::ConcurrencySetting::Algorithm::AIMD) {
+        return;
+    }
+
+    int current = limit.load(std::memory_order_relaxed);
+    auto target = std::chrono::milliseconds(setting.target_latency_ms);
+    if(failed || latency > target) {
+        std::int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
+        std::int64_t last = last_decrease.load(std::memory_order_relaxed);
+        if(now - last < std::chrono::steady_clock::duration(target).count() ||
+          !last_decrease.compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+            return; // decrease at most once per latency window, so one slow burst doesn't collapse the limit
+        }
+        int reduced = std::max(setting.min_limit, static_cast<int>(current * setting.backoff));
+        limit.store(reduced, std::memory_order_relaxed);
+        successes.store(0, std::memory_order_relaxed);
+        DEBUG("MW Concurrency", "latency=%ldms failed=%d, limit decreased %d -> %d", 
+            static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(latency).count()), failed, current, reduced);
+        return;
+    }
+
+    if(successes.fetch_add(1, std::memory_order_relaxed) + 1 < current || current >= setting.max_limit) {
+        return;
+    }
+    successes.store(0, std::memory_order_relaxed);
+    limit.compare_exchange_strong(current, current + 1, std::memory_order_relaxed); // +1 per window of successful requests
+}
+
+void mw::ConcurrencyLimiter::release(std::chrono::steady_clock::duration latency, bool failed) {
+    adapt(latency, failed);
+    in_flight.fetch_sub(1);
+    if(queued.load() == 0) {
+        return;
+    }
+    std::lock_guard lock(waiters_mutex);
+    grantWaiters();
+}
+
+asio::awaitable<http::Result<>> mw::ConcurrencyLimiter::process(Transaction* txn, Next next) {
+    if(!tryAcquire()) {
+        asio::error_code ec = co_await enqueue();
+        if(ec) {
+            std::unordered_map<std::string, std::string> headers;
+            headers["Retry-After"] = std::to_string(std::max(1, (setting.queue_timeout_ms + 999) / 1000));
+            co_return http::Error{http::code::Service_Unavailable,
+                std::format("client={} shed from [{} {}]: {} (limit={} in_flight={} queued={})",
+                txn->getSocket()->getIP(), http::method_enum_to_str(txn->getRequest()->method), txn->getRequest()->endpoint_url,
+                ec == asio::error::timed_out ? "queue timeout" : "queue full", limit.load(), in_flight.load(), queued.load()), std::move(headers)};
+        }
+    }
+    txn->permits.push_back(std::make_shared<Permit>(this, txn));
+
+    if(next) {
+        co_return co_await next();
+    }
+    co_return http::Result<>{};
+}
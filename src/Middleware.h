@@ -4,6 +4,8 @@
 #include <asio.hpp>
 #include <asio/awaitable.hpp>
 #include <exception>
+#include <deque>
+#include <jwt-cpp/traits/nlohmann-json/defaults.h>
 #include "Transaction.h"
 #include "MethodHandler.h"
 #include "config.h"
@@ -14,13 +16,17 @@ class Session;
 
 namespace mw {
 
-using Next = std::function<asio::awaitable<void>()>;
+using Next = std::function<asio::awaitable<http::Result<>>()>;
 
+/* 
+ * A middleware rejects a request by returning an http::Error rather than throwing, the error travels back
+ * through the earlier middlewares to mw::ErrorHandler. Exceptions are still caught there as a fallback.
+ */
 class Middleware
 {
     public:
     Middleware(): config(cfg::Config::getInstance()) {}
-    virtual asio::awaitable<void> process(Transaction* txn, Next next) = 0;
+    virtual asio::awaitable<http::Result<>> process(Transaction* txn, Next next) = 0;
     virtual ~Middleware() = default;
     protected:
     const cfg::Config* config;
@@ -34,35 +40,75 @@ struct Pipeline {
 class ErrorHandler: public Middleware 
 {
     public:
-    asio::awaitable<void> process(Transaction* txn, Next next) override;  
+    asio::awaitable<http::Result<>> process(Transaction* txn, Next next) override;  
 };
 
 class Logger: public Middleware
 {
     public:
-    asio::awaitable<void> process(Transaction* txn, Next next) override;
+    asio::awaitable<http::Result<>> process(Transaction* txn, Next next) override;
     private:
 };
 
 class Parser: public Middleware
 {
     public:
-    asio::awaitable<void> process(Transaction* txn, Next next) override;
+    asio::awaitable<http::Result<>> process(Transaction* txn, Next next) override;
     private:
 };
 
+class LoadShedder: public Middleware
+{
+    public:
+    asio::awaitable<http::Result<>> process(Transaction* txn, Next next) override;
+};
+
+struct VerifiedToken {
+    std::string token; // compared on lookup, the map is keyed by the token's hash
+    const cfg::Role* role; // resolved once on insert, nullptr if the claim names an unknown role
+    std::chrono::system_clock::time_point expires_at;
+    std::uint64_t generation; // revocation list generation at insert, any newer revocation invalidates the entry
+};
+
+/* Sharded cache of tokens that passed signature verification, keyed by token hash */
+class TokenCache
+{
+    public:
+    static constexpr std::size_t SHARD_COUNT = 16;
+    static constexpr std::size_t SHARD_CAPACITY = 1024;
+    static constexpr auto MAX_TTL = std::chrono::minutes(5); // bounds entries for tokens without an expiry
+
+    bool find(const std::string& token, std::uint64_t generation, const cfg::Role*& role);
+    void insert(const std::string& token, const cfg::Role* role, std::chrono::system_clock::time_point expires_at, std::uint64_t generation);
+
+    private:
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::unordered_map<std::size_t, VerifiedToken> entries;
+    };
+    std::array<Shard, SHARD_COUNT> shards;
+};
+
 class Authenticator: public Middleware
 {
 public:
-    asio::awaitable<void> process(Transaction* txn, Next next) override;
+    Authenticator();
+    asio::awaitable<http::Result<>> process(Transaction* txn, Next next) override;
 
 private:
-    void validate(Transaction* txn, const http::EndpointMethod* route);
+    using Verifier = decltype(jwt::verify());
+    jwt::algorithm::hs256 signer;
+    Verifier verifier; // built once per config, verification is const and shared across threads
+    TokenCache token_cache;
+
+private:
+    http::Result<> validate(Transaction* txn, const http::EndpointMethod* route);
+    http::Result<const cfg::Role*> verify(Transaction* txn, const std::string& token);
 };
 
 class RateLimiter: public Middleware
 {
-    asio::awaitable<void> process(Transaction* txn, Next next) override;
+    asio::awaitable<http::Result<>> process(Transaction* txn, Next next) override;
 };
 
 struct IpInfo {
@@ -75,7 +121,7 @@ class FixedWindowLimiter: public Middleware
     public:
     FixedWindowLimiter(cfg::FixedWindowSetting setting): setting(setting) {clients.reserve(2048);} // avoid reshashing, could possibly add expired client removal
     FixedWindowLimiter() {clients.reserve(2048);} // avoid reshashing, could possibly add expired client removal
-    asio::awaitable<void> process(Transaction* txn, Next next) override;
+    asio::awaitable<http::Result<>> process(Transaction* txn, Next next) override;
     private:
     std::unordered_map<std::string, std::unique_ptr<IpInfo>> clients;
     cfg::FixedWindowSetting setting;
@@ -94,7 +140,7 @@ class TokenBucketLimiter: public Middleware
 {
     public:
     TokenBucketLimiter(cfg::TokenBucketSetting&& setting): setting(setting) {buckets.reserve(2048);}
-    asio::awaitable<void> process(Transaction* txn, Next next) override;
+    asio::awaitable<http::Result<>> process(Transaction* txn, Next next) override;
 
     private:
     cfg::TokenBucketSetting setting;
@@ -104,5 +150,60 @@ class TokenBucketLimiter: public Middleware
     private:
     Bucket* findBucket(const std::string& identifier);
 };
+
+class Bulkhead: public Middleware
+{
+    asio::awaitable<http::Result<>> process(Transaction* txn, Next next) override;
+};
+
+class ConcurrencyLimiter;
+
+/* Holds one in-flight slot, returned to the limiter on destruction */
+struct Permit {
+    ConcurrencyLimiter* limiter;
+    Transaction* txn;
+    std::chrono::steady_clock::time_point start{std::chrono::steady_clock::now()};
+
+    Permit(ConcurrencyLimiter* limiter, Transaction* txn): limiter(limiter), txn(txn) {}
+    Permit(const Permit&) = delete;
+    Permit& operator=(const Permit&) = delete;
+    ~Permit();
+};
+
+struct Waiter {
+    asio::steady_timer timer;
+    std::function<void(asio::error_code)> complete;
+
+    Waiter(const asio::any_io_executor& executor): timer(executor) {}
+    void notify(asio::error_code ec) {
+        auto handler = std::move(complete);
+        complete = nullptr;
+        handler(ec);
+    }
+};
+
+class ConcurrencyLimiter: public Middleware
+{
+    public:
+    ConcurrencyLimiter(cfg::ConcurrencySetting setting): setting(setting), limit(setting.max_in_flight) {}
+    asio::awaitable<http::Result<>> process(Transaction* txn, Next next) override;
+    void release(std::chrono::steady_clock::duration latency, bool failed);
+
+    private:
+    cfg::ConcurrencySetting setting;
+    std::atomic<int> limit;
+    std::atomic<int> in_flight{0};
+    std::atomic<int> queued{0};
+    std::atomic<int> successes{0};
+    std::atomic<std::int64_t> last_decrease{0};
+    std::deque<std::shared_ptr<Waiter>> waiters;
+    std::mutex waiters_mutex;
+
+    private:
+    bool tryAcquire();
+    void grantWaiters();
+    void adapt(std::chrono::steady_clock::duration latency, bool failed);
+    asio::awaitable<asio::error_code> enqueue();
+};
 };
 #endif
\ No newline at end of file
@@ -19,14 +19,13 @@ asio::awaitable<void> PostHandler::handle() {
             std::format("Failed to parse response from script"));
         }
 
-        response->body = http::extract_body(buffer);
-        auto headers = http::extract_headers(buffer);
-        response->addHeaders(headers);
+        auto body = http::extract_body(buffer);
+        if(!body || !http::extract_headers(buffer, response->headers)) {
+            throw http::HTTPException(http::code::Bad_Gateway, 
+            std::format("Failed to parse response from script"));
+        }
         response->addHeader("Connection", "close");
-        std::string response_str = response->build();
-
-        std::span<const char> header_buf(response_str.data(), response_str.length());
-        http::io::WriteStatus result = co_await http::io::co_write_all(sock, header_buf);
+        http::io::WriteStatus result = co_await http::io::co_write_response(sock, response, *body);
         if(!http::is_success_code(result.status)) {
             throw http::HTTPException(result.status, std::move(result.message));
         }
@@ -0,0 +1,54 @@
+#ifndef RESULT_H
+#define RESULT_H
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+
+namespace http {
+    enum class code : int;
+
+    /* A routine failure (404, 405, 401, 429 ...) returned by value, mw::ErrorHandler turns it into the error response */
+    struct Error {
+        code status;
+        std::string message;
+        std::unordered_map<std::string, std::string> headers{}; // per request headers, e.g. Retry-After
+    };
+
+    /* 
+     * Holds a value or an Error, like std::expected. Routine outcomes on the request path are returned through it,
+     * HTTPException is left for failures that are actually exceptional.
+     */
+    template <typename T = void>
+    class Result {
+        public:
+        Result(T value): state(std::in_place_index<0>, std::move(value)) {}
+        Result(Error&& error): state(std::in_place_index<1>, std::move(error)) {}
+
+        explicit operator bool() const noexcept {return state.index() == 0;}
+        T& operator*() {return std::get<0>(state);}
+        const T& operator*() const {return std::get<0>(state);}
+        T* operator->() {return &std::get<0>(state);}
+        const T* operator->() const {return &std::get<0>(state);}
+        Error& error() {return std::get<1>(state);}
+
+        private:
+        std::variant<T, Error> state;
+    };
+
+    template <>
+    class Result<void> {
+        public:
+        Result() {}
+        Result(Error&& error): state(std::in_place_index<1>, std::move(error)) {}
+
+        explicit operator bool() const noexcept {return state.index() == 0;}
+        Error& error() {return std::get<1>(state);}
+
+        private:
+        std::variant<std::monostate, Error> state;
+    };
+};
+
+#endif
@@ -0,0 +1,216 @@
+#include "Revocation.h"
+
+#include <fstream>
+#include <sstream>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+
+static std::string to_hex(const unsigned char* bytes, std::size_t len) {
+    static constexpr char digits[] = "0123456789abcdef";
+    std::string hex(len * 2, '0');
+    for(std::size_t i = 0; i < len; ++i) {
+        hex[2 * i] = digits[bytes[i] >> 4];
+        hex[2 * i + 1] = digits[bytes[i] & 0x0f];
+    }
+    return hex;
+}
+
+std::string token_digest(std::string_view token) {
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int len = 0;
+    if(!EVP_Digest(token.data(), token.size(), digest, &len, EVP_sha256(), nullptr)) {
+        return "";
+    }
+    return to_hex(digest, len);
+}
+
+std::string generate_token_id() {
+    unsigned char id[16];
+    if(RAND_bytes(id, sizeof(id)) != 1) {
+        ERROR("Revocation", "failed to generate token id");
+        return "";
+    }
+    return to_hex(id, sizeof(id));
+}
+
+/* splitmix64 finalizer, derives the second hash for double hashing */
+static std::uint64_t mix(std::uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+bool BloomFilter::mayContain(std::string_view key) const {
+    std::uint64_t h1 = std::hash<std::string_view>{}(key);
+    std::uint64_t h2 = mix(h1) | 1;
+    for(std::size_t i = 0; i < HASHES; ++i) {
+        std::size_t bit = (h1 + i * h2) % BITS;
+        if(!(words[bit / 64].load(std::memory_order_relaxed) & (1ULL << (bit % 64)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void BloomFilter::add(std::string_view key) {
+    std::uint64_t h1 = std::hash<std::string_view>{}(key);
+    std::uint64_t h2 = mix(h1) | 1;
+    for(std::size_t i = 0; i < HASHES; ++i) {
+        std::size_t bit = (h1 + i * h2) % BITS;
+        words[bit / 64].fetch_or(1ULL << (bit % 64), std::memory_order_relaxed);
+    }
+}
+
+void BloomFilter::clear() {
+    for(auto& word : words) {
+        word.store(0, std::memory_order_relaxed);
+    }
+}
+
+RevocationList RevocationList::INSTANCE;
+
+RevocationList* RevocationList::getInstance() {
+    return &RevocationList::INSTANCE;
+}
+
+void RevocationList::start(asio::io_context& io_context, const cfg::RevocationConfig* setting) {
+    this->setting = setting;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        reload();
+    }
+    asio::co_spawn(io_context, maintain(), asio::detached);
+    DEBUG("Revocation", "loaded %zu revoked tokens, file=%s interval=%dms", entries.size(),
+        setting->file_path.empty() ? "none" : setting->file_path.c_str(), setting->reload_interval_ms);
+}
+
+bool RevocationList::isRevoked(std::string_view key) const {
+    if(key.empty() || !filters[active.load(std::memory_order_acquire)].mayContain(key)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(std::string(key));
+    return it != entries.end() && std::chrono::system_clock::now() <= it->second;
+}
+
+void RevocationList::revoke(const std::string& key, time_point expires_at) {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries[key] = expires_at;
+    filters[active.load(std::memory_order_relaxed)].add(key); // writers are serialized by the mutex, no bits are lost to a swap
+    generation.fetch_add(1, std::memory_order_release);
+    append(key, expires_at);
+    INFO("Revocation", "revoked token=%s", key.c_str());
+}
+
+/* mutex held, persists an admin revocation so it survives a reload or restart */
+void RevocationList::append(const std::string& key, time_point expires_at) {
+    if(setting->file_path.empty()) {
+        return;
+    }
+    std::ofstream file(setting->file_path, std::ios::app);
+    if(!file) {
+        ERROR("Revocation", "failed to open %s, revocation of %s will not survive a reload", setting->file_path.c_str(), key.c_str());
+        return;
+    }
+    file << key;
+    if(expires_at != time_point::max()) {
+        file << " " << std::chrono::system_clock::to_time_t(expires_at);
+    }
+    file << "\n";
+    file.close();
+
+    std::error_code ec;
+    auto write_time = std::filesystem::last_write_time(setting->file_path, ec);
+    if(!ec) {
+        last_write = write_time; // our own write, no need to reload
+    }
+}
+
+/* mutex held, returns true if the file changed and was loaded. Lines are "<jti or token digest> [expiry unix time]" */
+bool RevocationList::reload() {
+    if(setting->file_path.empty()) {
+        return false;
+    }
+
+    std::error_code ec;
+    auto write_time = std::filesystem::last_write_time(setting->file_path, ec);
+    if(ec) {
+        WARN("Revocation", "failed to stat revocation file %s: %s", setting->file_path.c_str(), ec.message().c_str());
+        return false;
+    }
+    if(write_time == last_write) {
+        return false;
+    }
+
+    std::ifstream file(setting->file_path);
+    if(!file) {
+        ERROR("Revocation", "failed to open revocation file %s", setting->file_path.c_str());
+        return false;
+    }
+
+    auto now = std::chrono::system_clock::now();
+    std::unordered_map<std::string, time_point> loaded;
+    std::string line;
+    while(std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string key;
+        if(!(fields >> key) || key[0] == '#') {
+            continue;
+        }
+        time_point expires_at = time_point::max();
+        long long expiry;
+        if(fields >> expiry) {
+            expires_at = std::chrono::system_clock::from_time_t(static_cast<std::time_t>(expiry));
+        }
+        if(now <= expires_at) {
+            loaded[key] = expires_at;
+        }
+    }
+
+    entries = std::move(loaded);
+    last_write = write_time;
+    rebuildFilter();
+    generation.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+/* mutex held */
+void RevocationList::prune() {
+    auto now = std::chrono::system_clock::now();
+    if(std::erase_if(entries, [now](const auto& entry) { return now > entry.second; }) > 0) {
+        rebuildFilter(); // bloom filters can't delete, start over from the live entries
+    }
+}
+
+/*
+ * mutex held, fills the inactive filter and swaps it in. The filter being cleared was retired at least one
+ * maintenance interval ago, any lookup still reading it has long finished.
+ */
+void RevocationList::rebuildFilter() {
+    std::size_t next = 1 - active.load(std::memory_order_relaxed);
+    filters[next].clear();
+    for(const auto& [key, expires_at] : entries) {
+        filters[next].add(key);
+    }
+    active.store(next, std::memory_order_release);
+}
+
+asio::awaitable<void> RevocationList::maintain() {
+    asio::steady_timer timer(co_await asio::this_coro::executor);
+    while(true) {
+        timer.expires_after(std::chrono::milliseconds(setting->reload_interval_ms));
+        auto [ec] = co_await timer.async_wait(asio::as_tuple(asio::use_awaitable));
+        if(ec) {
+            co_return;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if(reload()) { // a reload already drops expired entries
+            INFO("Revocation", "reloaded %zu revoked tokens from %s", entries.size(), setting->file_path.c_str());
+        } else {
+            prune();
+        }
+    }
+}
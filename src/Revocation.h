@@ -0,0 +1,82 @@
+#ifndef REVOCATION_H
+#define REVOCATION_H
+
+#include <asio.hpp>
+#include <asio/awaitable.hpp>
+#include <asio/steady_timer.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "config.h"
+
+/* Returns the hex sha256 of a raw token, used to revoke tokens issued without a jti */
+std::string token_digest(std::string_view token);
+/* Random 128 bit hex id for the jti claim of issued tokens */
+std::string generate_token_id();
+
+/*
+ * Fixed size Bloom filter over atomic words, lookups and inserts never lock.
+ * At ~50k entries the false positive rate is ~0.1%, a false positive only costs an exact lookup.
+ */
+class BloomFilter
+{
+    public:
+    static constexpr std::size_t BITS = 1 << 20;
+    static constexpr std::size_t HASHES = 4;
+
+    bool mayContain(std::string_view key) const;
+    void add(std::string_view key);
+    void clear();
+
+    private:
+    std::array<std::atomic<std::uint64_t>, BITS / 64> words{};
+};
+
+/*
+ * Revoked token ids (jti) and token digests. The filter answers the common "not revoked" case,
+ * hits are confirmed against the exact set. Entries come from the configured file, which is
+ * reloaded when modified, and from the admin revoke endpoint, which appends to the file.
+ */
+class RevocationList
+{
+    public:
+    using time_point = std::chrono::system_clock::time_point;
+
+    static RevocationList* getInstance();
+    void start(asio::io_context& io_context, const cfg::RevocationConfig* setting);
+
+    bool isRevoked(std::string_view key) const;
+    void revoke(const std::string& key, time_point expires_at);
+    std::uint64_t getGeneration() const {return generation.load(std::memory_order_acquire);} // bumped whenever an entry is added
+
+    private:
+    static RevocationList INSTANCE;
+    const cfg::RevocationConfig* setting{nullptr};
+
+    std::array<BloomFilter, 2> filters; // the inactive filter is rebuilt and swapped in after a reload or prune
+    std::atomic<std::size_t> active{0};
+    std::atomic<std::uint64_t> generation{0};
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, time_point> entries;
+    std::filesystem::file_time_type last_write{};
+
+    private:
+    RevocationList() {}
+    RevocationList(const RevocationList&) = delete;
+    RevocationList& operator=(const RevocationList&) = delete;
+
+    asio::awaitable<void> maintain();
+    bool reload();
+    void prune();
+    void rebuildFilter();
+    void append(const std::string& key, time_point expires_at);
+};
+
+#endif
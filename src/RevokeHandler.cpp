@@ -0,0 +1,44 @@
+#include "MethodHandler.h"
+#include "Revocation.h"
+#include <jwt-cpp/traits/nlohmann-json/defaults.h>
+
+asio::awaitable<void> RevokeHandler::handle() {
+    http::json body = parseJSONBody("revoke");
+
+    std::string key;
+    auto expires_at = std::chrono::system_clock::time_point::max();
+    if(body.contains("token") && body["token"].is_string()) {
+        std::string token = body["token"];
+        key = token_digest(token);
+        try {
+            auto decoded_token = jwt::decode(token);
+            if(decoded_token.has_id()) {
+                key = decoded_token.get_id();
+            }
+            if(decoded_token.has_expires_at()) {
+                expires_at = decoded_token.get_expires_at();
+            }
+        } catch (const std::exception& error) {
+            DEBUG("Revoke Handler", "revoking undecodable token by digest: %s", error.what());
+        }
+    } else if (body.contains("jti") && body["jti"].is_string()) {
+        key = body["jti"];
+    }
+    if(key.empty()) {
+        throw http::HTTPException(http::code::Bad_Request, std::format("revoke request from client={} is missing a jti or token", sock->getIP()));
+    }
+
+    if(body.contains("expires")) {
+        try {
+            long long expiry = body["expires"].is_string() ? std::stoll(body["expires"].get<std::string>()) : body["expires"].get<long long>();
+            expires_at = std::chrono::system_clock::from_time_t(static_cast<std::time_t>(expiry));
+        } catch (const std::exception&) {
+            throw http::HTTPException(http::code::Bad_Request, std::format("revoke request from client={} has an invalid expiry", sock->getIP()));
+        }
+    }
+
+    RevocationList::getInstance()->revoke(key, expires_at);
+
+    http::json reply = {{"revoked", key}};
+    co_await sendJSON(reply);
+}
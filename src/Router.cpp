@@ -5,6 +5,8 @@
 #include "MethodHandler.h"
 #include "Middleware.h"
 
+#include <fstream>
+
 using namespace http;
 using namespace cfg;
 
@@ -12,10 +14,60 @@ static http::Endpoint ROOT_ENDPOINT;
 static http::ErrorPage DEFAULT_ERROR_PAGE;
 Router Router::INSTANCE;
 
+static constexpr http::code ERROR_CODES[] = {
+    code::Bad_Request, code::Unauthorized, code::Forbidden, code::Not_Found, code::Method_Not_Allowed, code::Request_Timeout, code::Unsupported_Media_Type,
+    code::Too_Many_Requests, code::Client_Closed_Request, code::Internal_Server_Error, code::Not_Implemented, code::Bad_Gateway,
+    code::Service_Unavailable, code::Gateway_Timeout, code::Insufficient_Storage
+};
+
+/* status line and fixed headers of a prebuilt response, the Date and other per request headers follow when sent */
+static std::string canned_head(http::code status, std::initializer_list<std::pair<std::string_view, std::string_view>> headers) {
+    std::string head(http::get_status_msg(status));
+    head += "\r\n";
+    for(auto& [key, value] : headers) {
+        head.append(key).append(": ").append(value).append("\r\n");
+    }
+    return head;
+}
+
+static http::ErrorPage canned_error_page(http::code status, std::string&& body, const std::string& content_type) {
+    std::string length = std::to_string(body.size());
+    std::string head = content_type.empty() ? 
+        canned_head(status, {{"Connection", "close"}, {"Content-Length", length}}) : 
+        canned_head(status, {{"Connection", "close"}, {"Content-Type", content_type}, {"Content-Length", length}});
+    
+    http::ErrorPage error_page;
+    error_page.status = status;
+    error_page.handler = [head = std::move(head), body = std::move(body)](Transaction* txn) -> asio::awaitable<void> {
+        auto result = co_await http::io::co_write_canned(txn->getSocket(), txn->getResponse(), head, body);
+        if(!http::is_success_code(result.status)) {
+            DEBUG("MW Error Handler", "failed to send error page: status=%d, message=%s", static_cast<int>(result.status), result.message.c_str());
+        }
+        co_return;
+    };
+    return error_page;
+}
+
+static std::string get_methods_str(const std::vector<http::method>& methods) {
+    std::string allow_header = "";
+    for(auto method : methods) {
+        allow_header += std::string(http::method_enum_to_str(method)) + ", ";
+    }
+    if(!allow_header.empty()) {
+        allow_header.erase(allow_header.size() - 2, 2);
+    }
+    return allow_header;
+}
+
 Router::Router() {
+    for(http::code status : ERROR_CODES) {
+        error_pages[status] = canned_error_page(status, "", "");
+    }
+
     ROOT_ENDPOINT.addMethod({
     .m = http::method::Get,
     .access_role = VIEWER_ROLE_HASH,
+    .access_role_id = VIEWER_ROLE_ID,
     .auth_role = "",
     .is_protected = false,
     .is_authenticator = false,
@@ -31,6 +83,7 @@ Router::Router() {
     ROOT_ENDPOINT.addMethod({
         .m = http::method::Head,
         .access_role = VIEWER_ROLE_HASH,
+        .access_role_id = VIEWER_ROLE_ID,
         .auth_role = "",
         .is_protected = false,
         .is_authenticator = false,
@@ -44,9 +97,10 @@ Router::Router() {
     });
     endpoints["/"] = ROOT_ENDPOINT;
 
-    DEFAULT_ERROR_PAGE.handler = [](Transaction* txn) -> asio::awaitable<void> {
-        std::string response = txn->response.build();
-        auto result = co_await http::io::co_write_all(txn->getSocket(), std::span<const char>(response.data(), response.length()));
+    DEFAULT_ERROR_PAGE.handler = [](Transaction* txn) -> asio::awaitable<void> { // statuses without a prebuilt page
+        txn->getResponse()->addHeader("Connection", "close");
+        txn->getResponse()->addHeader("Content-Length", "0");
+        auto result = co_await http::io::co_write_response(txn->getSocket(), txn->getResponse());
         if(!http::is_success_code(result.status)) {
             DEBUG("MW Error Handler", "failed to execute default error handler: status=%d, message=%s", static_cast<int>(result.status), result.message.c_str());
         }
@@ -108,14 +162,14 @@ static http::Handler assign_handler(method m) {
 }
 
 static http::EndpointMethod create_default_endpoint_method(const std::string& endpoint, method m) {
-    return http::EndpointMethod{m, cfg::VIEWER_ROLE_HASH, "", false, false, endpoint, false, arg_type::None, assign_handler(m), {}};
+    return http::EndpointMethod{m, cfg::VIEWER_ROLE_HASH, cfg::VIEWER_ROLE_ID, "", false, false, endpoint, false, arg_type::None, assign_handler(m), {}};
 }
 
-const http::Endpoint* Router::getEndpoint(const std::string& endpoint) {
+http::Result<const http::Endpoint*> Router::getEndpoint(const std::string& endpoint) {
     auto it = endpoints.find(endpoint);
     if(it == endpoints.end()) {
         if (!file_exists("public" + endpoint)) {
-            throw http::HTTPException(http::code::Not_Found, std::format("request for {}: does not exist", endpoint));
+            return http::Error{http::code::Not_Found, std::format("request for {}: does not exist", endpoint)};
         }
         http::Endpoint ep;
         ep.addMethod(create_default_endpoint_method("public" + endpoint, http::method::Get));
@@ -126,9 +180,12 @@ const http::Endpoint* Router::getEndpoint(const std::string& endpoint) {
     return &it->second;
 }
 
-const http::EndpointMethod* Router::getEndpointMethod(const std::string& endpoint_url, http::method m) {
+http::Result<const http::EndpointMethod*> Router::getEndpointMethod(const std::string& endpoint_url, http::method m) {
     auto endpoint = getEndpoint(endpoint_url);
-    return endpoint->getMethod(m);
+    if(!endpoint) {
+        return std::move(endpoint.error());
+    }
+    return (*endpoint)->getMethod(m);
 }
 
 const http::ErrorPage* Router::getErrorPage(http::code status) const {
@@ -139,38 +196,36 @@ const http::ErrorPage* Router::getErrorPage(http::code status) const {
     return &it->second;
 }
 
+/* the page is read once here, a page that can't be read keeps the default */
 void Router::addErrorPage(ErrorPage&& error_page, std::string&& file) {
-    error_page.handler = [file_path = std::move(file), status = error_page.status](Transaction* txn) -> asio::awaitable<void> {
-        try {
-            FileStreamer f_stream(file_path);
-            txn->getResponse()->addHeader("Content-Length", std::to_string(f_stream.getFileSize()));
-            std::string response = txn->getResponse()->build();
-            StringStreamer s_stream(&response);
-            co_await s_stream.stream(txn->getSocket());
-            co_await f_stream.stream(txn->getSocket());
-            co_return;
-        } catch (const std::exception& error) {
-            WARN("Error Page Handler", "failed to serve error page %s for code=%d: %s", 
-            file_path.c_str(), static_cast<int>(status), error.what());
-        } 
-        
-        co_await DEFAULT_ERROR_PAGE.handler(txn); // if sending the error page fails, simply send the original error
-        co_return;
-    };
-    error_pages[error_page.status] = std::move(error_page);
+    std::ifstream page_file(file, std::ios::binary);
+    if(!page_file) {
+        WARN("Server", "failed to read error page %s for code=%d, serving the default", file.c_str(), static_cast<int>(error_page.status));
+        return;
+    }
+    std::string body((std::istreambuf_iterator<char>(page_file)), std::istreambuf_iterator<char>());
+    std::string content_type;
+    if(http::determine_content_type(file, content_type) != http::code::OK) {
+        content_type.clear();
+    }
+    error_pages[error_page.status] = canned_error_page(error_page.status, std::move(body), content_type);
 }
 
 void http::Router::updateEndpoint(const std::string& endpoint_url, EndpointMethod&& method) {
     auto it = endpoints.find(endpoint_url);
     if(it == endpoints.end()) {
         http::Endpoint endpoint;
-        method.handler = assign_handler(method.m);
+        if(!method.handler) { // admin routes come with their own handler
+            method.handler = assign_handler(method.m);
+        }
         endpoint.addMethod(std::move(method));
         endpoints[endpoint_url] = endpoint;    
         return;
     }
     http::Endpoint& endpoint = it->second;
-    method.handler = assign_handler(method.m);
+    if(!method.handler) {
+        method.handler = assign_handler(method.m);
+    }
     endpoint.addMethod(std::move(method));
 }
 
@@ -180,88 +235,93 @@ void http::Endpoint::setEndpointURL(const std::string& url) {
     endpoint = url;
 }
 
-const http::EndpointMethod* http::Endpoint::getMethod(http::method m) const {
+http::Result<const EndpointMethod*> http::Endpoint::getMethod(http::method m) const {
     auto it = methods.find(m);
     if(it == methods.end()) {
-        throw http::HTTPException(http::code::Method_Not_Allowed, 
-        std::format("failed to retrieve method: {} {} does not exist", method_enum_to_str(m), endpoint));
+        return http::Error{http::code::Method_Not_Allowed, 
+        std::format("failed to retrieve method: {} {} does not exist", method_enum_to_str(m), endpoint)};
     }
     return &it->second;
 }
 
 void http::Endpoint::addMethod(EndpointMethod&& method) {
+    std::string content_type;
+    if(method.m == http::method::Head && http::determine_content_type(method.resource, content_type) == http::code::OK) {
+        method.canned_head = canned_head(code::OK, {{"Connection", "close"}, {"Content-Type", content_type}});
+    }
     methods[method.m] = std::move(method);
+    options_head = canned_head(code::OK, {{"Allow", get_methods_str(getMethods())}, {"Content-Length", "0"}, {"Connection", "close"}});
 }
 
-bool http::Endpoint::isMethodProtected(method m) const {
+http::Result<bool> http::Endpoint::isMethodProtected(http::method m) const {
     auto it = methods.find(m);
     if(it == methods.end()) {
-        throw http::HTTPException(http::code::Method_Not_Allowed, 
-        std::format("failed to retrieve protection status: {} {} does not exist", method_enum_to_str(m), endpoint)); 
+        return http::Error{http::code::Method_Not_Allowed, 
+        std::format("failed to retrieve protection status: {} {} does not exist", method_enum_to_str(m), endpoint)};
     }
-    return it->second.is_protected; 
+    return it->second.is_protected;
 }
 
-bool http::Endpoint::hasScript(method m) const {
+http::Result<bool> http::Endpoint::hasScript(http::method m) const {
     auto it = methods.find(m);
     if(it == methods.end()) {
-        throw http::HTTPException(http::code::Method_Not_Allowed, 
-        std::format("failed to retrieve script status: {} {} does not exist", method_enum_to_str(m), endpoint)); 
+        return http::Error{http::code::Method_Not_Allowed, 
+        std::format("failed to retrieve script status: {} {} does not exist", method_enum_to_str(m), endpoint)};
     }
-    return it->second.has_script; 
+    return it->second.has_script;
 }
 
-arg_type http::Endpoint::getArgType(http::method m) const {
+http::Result<http::arg_type> http::Endpoint::getArgType(http::method m) const {
     auto it = methods.find(m);
     if(it == methods.end()) {
-        throw http::HTTPException(http::code::Method_Not_Allowed, 
-        std::format("failed to retrieve argument type: {} {} does not exist", method_enum_to_str(m), endpoint));  
+        return http::Error{http::code::Method_Not_Allowed, 
+        std::format("failed to retrieve argument type: {} {} does not exist", method_enum_to_str(m), endpoint)};
     }
     return it->second.args;
 }
 
-std::string http::Endpoint::getAuthRole(method m) const {
+http::Result<std::string> http::Endpoint::getAuthRole(http::method m) const {
     auto it = methods.find(m);
     if(it == methods.end()) {
-        throw http::HTTPException(http::code::Method_Not_Allowed, 
-        std::format("failed to retrieve auth role: {} {} does not exist", method_enum_to_str(m), endpoint)); 
+        return http::Error{http::code::Method_Not_Allowed, 
+        std::format("failed to retrieve auth role: {} {} does not exist", method_enum_to_str(m), endpoint)};
     }
     return it->second.auth_role;
 }
 
-bool http::Endpoint::isMethodAuthenticator(method m) const {
+http::Result<bool> http::Endpoint::isMethodAuthenticator(http::method m) const {
     auto it = methods.find(m);
     if(it == methods.end()) {
-        throw http::HTTPException(http::code::Method_Not_Allowed, 
-        std::format("failed to retrieve authenticator status: {} {} does not exist", method_enum_to_str(m), endpoint)); 
+        return http::Error{http::code::Method_Not_Allowed, 
+        std::format("failed to retrieve authenticator status: {} {} does not exist", method_enum_to_str(m), endpoint)};
     }
     return it->second.is_authenticator;
 }
 
-std::string http::Endpoint::getResource(method m) const {
+http::Result<std::string> http::Endpoint::getResource(http::method m) const {
     auto it = methods.find(m);
     if(it == methods.end()) {
-        throw http::HTTPException(http::code::Method_Not_Allowed, 
-        std::format("failed to retrieve script: {} {} does not exist", method_enum_to_str(m), endpoint)); 
+        return http::Error{http::code::Method_Not_Allowed, 
+        std::format("failed to retrieve script: {} {} does not exist", method_enum_to_str(m), endpoint)};
     }
     return it->second.resource;
 }
 
-std::string http::Endpoint::getAccessRole(http::method m) const {
+http::Result<std::string> http::Endpoint::getAccessRole(http::method m) const {
     auto it = methods.find(m);
     if(it == methods.end()) {
-        throw http::HTTPException(http::code::Method_Not_Allowed, 
-        std::format("failed to retrieve access role: {} {} does not exist", method_enum_to_str(m), endpoint)); 
+        return http::Error{http::code::Method_Not_Allowed, 
+        std::format("failed to retrieve access role: {} {} does not exist", method_enum_to_str(m), endpoint)};
     }
     return it->second.access_role;
 }
 
-http::Handler http::Endpoint::getHandler(http::method m) const {
+http::Result<http::Handler> http::Endpoint::getHandler(http::method m) const {
     auto it = methods.find(m);
     if(it == methods.end()) {
         if(m != http::method::Get && m != http::method::Head) {
-            throw http::HTTPException(http::code::Method_Not_Allowed, 
-            std::format("failed to retrieve handler {} {} does not exist", http::method_enum_to_str(m), endpoint));
+            return http::Error{http::code::Method_Not_Allowed, 
+            std::format("failed to retrieve handler {} {} does not exist", http::method_enum_to_str(m), endpoint)};
         } 
         return assign_handler(m); 
     }
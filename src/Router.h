@@ -1,3 +1,6 @@
+// ahead of the guard, config.h includes http.h which needs this header in full, included first it comes back in through there
+#include "config.h"
+
 #ifndef ROUTER_H
 #define ROUTER_H
 
@@ -5,10 +8,13 @@
 #include <unordered_map>
 #include <string>
 #include <functional>
+#include <cstdint>
 #include <asio.hpp>
 #include <asio/awaitable.hpp>
 #include <asio/use_awaitable.hpp>
 
+#include "Result.h"
+
 namespace http {
     class Request;
     enum class method : int;
@@ -44,6 +50,7 @@ namespace http {
     struct EndpointMethod {
         method m;
         std::string access_role; // role required to access the endpoint
+        cfg::RoleID access_role_id{0}; // compiled access_role, checked against the client's role grants
         std::string auth_role;
         bool is_protected{false};
         bool is_authenticator{false};
@@ -52,27 +59,32 @@ namespace http {
         http::arg_type args{arg_type::None};
         Handler handler;
         std::shared_ptr<mw::Middleware> rate_limiter;
+        std::shared_ptr<mw::Middleware> concurrency_limiter{};
+        std::uint32_t log_sample{1}; // log 1 in log_sample successful requests, errors are always logged
+        std::string canned_head{}; // HEAD routes, prebuilt status line and headers, the Content-Length is added per request
     };
 
     class Endpoint {
         public:
         Endpoint();
-        const EndpointMethod* getMethod(method m) const;
-        bool isMethodProtected(method m) const;
-        bool isMethodAuthenticator(method m) const;
-        bool hasScript(method m) const;
-        std::string getAuthRole(method m) const;
-        std::string getAccessRole(method m) const;
-        std::string getResource(method m) const;
-        arg_type getArgType(method m) const;
-        Handler getHandler(method m) const;
+        Result<const EndpointMethod*> getMethod(method m) const;
+        Result<bool> isMethodProtected(method m) const;
+        Result<bool> isMethodAuthenticator(method m) const;
+        Result<bool> hasScript(method m) const;
+        Result<std::string> getAuthRole(method m) const;
+        Result<std::string> getAccessRole(method m) const;
+        Result<std::string> getResource(method m) const;
+        Result<arg_type> getArgType(method m) const;
+        Result<Handler> getHandler(method m) const;
         std::vector<method> getMethods() const;
         void addMethod(EndpointMethod&& method);
         void setEndpointURL(const std::string& url);
+        const std::string& getOptionsHead() const {return options_head;}
 
         private:
         std::unordered_map<method, EndpointMethod> methods;
         std::string endpoint{""};
+        std::string options_head; // prebuilt OPTIONS response, rebuilt as methods are added
     };
 
     class Router 
@@ -81,8 +93,8 @@ namespace http {
 
         public:
         static Router* getInstance();
-        const Endpoint* getEndpoint(const std::string& endpoint);
-        const EndpointMethod* getEndpointMethod(const std::string& endpoint_url, http::method m);
+        Result<const Endpoint*> getEndpoint(const std::string& endpoint);
+        Result<const EndpointMethod*> getEndpointMethod(const std::string& endpoint_url, http::method m);
         const ErrorPage* getErrorPage(http::code status) const;
 
         private:
@@ -1,13 +1,20 @@
 #include "Server.h"
+#include "LoadMonitor.h"
+#include "Revocation.h"
+#include "Clock.h"
+#include "BufferPool.h"
+#include "TimerWheel.h"
+#include "TLS.h"
 
 #include <asio.hpp>
+#include <algorithm>
 #include <iostream>
 #include <string>
 
 Server::Server(const cfg::Config* server_config) 
     : _config(server_config),
       _io_context(),
-      _ssl_context(asio::ssl::context::tlsv12),
+      _ssl_context(asio::ssl::context::tls_server),
       _acceptor(),
       _endpoint(asio::ip::tcp::v4(), server_config->getPort()),
       _ssl(_config->getSSL()->active),
@@ -25,22 +32,53 @@ void Server::loadCertificate() {
     this->_ssl_context.set_options(asio::ssl::context::default_workarounds | // workaround common bugs
                                   asio::ssl::context::no_sslv2 | // disable sslv2
                                   asio::ssl::context::single_dh_use); // enable new dh use for each session
+    tls::configure(this->_ssl_context, ssl_config);
     this->_ssl_context.use_certificate_chain_file(ssl_config->certificate_path);
     this->_ssl_context.use_private_key_file(ssl_config->key_path, asio::ssl::context::pem); // privacy enhanced mail format
 }
 
+/* owns the session for the life of the connection, it is recycled when this returns */
+static asio::awaitable<void> serve(SessionHandle session) {
+    co_await session->start();
+}
+
 asio::awaitable<void> Server::run() {
     STATUS("Server", "%s is running on [%s %s:%d] pid=%ld", _config->getServerName().c_str(), asio::ip::host_name().c_str(), _config->getHostIP().c_str(), _config->getPort(), getpid());
     std::error_code ec;
+    auto monitor = LoadMonitor::getInstance();
+    asio::steady_timer pause_timer(_io_context);
     while(true) {
-        auto session = std::make_shared<Session>(createSocket());
+        while(monitor->shouldPauseAccept()) { // leave new connections in the backlog until the io threads catch up
+            pause_timer.expires_after(std::chrono::milliseconds(_config->getLoadShedding()->sample_interval_ms));
+            co_await pause_timer.async_wait(asio::use_awaitable);
+        }
+        SessionHandle session = Session::acquire([this]() {return createSocket();});
 
         co_await _acceptor->async_accept(session->getSocket()->getRawSocket(), asio::redirect_error(asio::use_awaitable, ec));
         if(isError(ec)) {
             co_return;
         }
 
-        co_await session->start();
+        // serve concurrently, limits on in-flight work are enforced by the pipeline. Each session runs on its own strand, the
+        // branches of a race inside it and the cancellation one sends the other never run on two threads at once
+        asio::co_spawn(asio::make_strand(_io_context), serve(std::move(session)), asio::detached);
+    }
+}
+
+/* SIGUSR1 lowers the log threshold one level (more verbose), SIGUSR2 raises it */
+asio::awaitable<void> Server::handleSignals() {
+    asio::signal_set signals(_io_context, SIGUSR1, SIGUSR2);
+    auto log = logger::Logger::getInstance();
+    while(true) {
+        auto [ec, signal] = co_await signals.async_wait(asio::as_tuple(asio::use_awaitable));
+        if(ec) {
+            co_return;
+        }
+        int threshold = static_cast<int>(log->getThreshold());
+        threshold += (signal == SIGUSR1) ? -1 : 1;
+        threshold = std::clamp(threshold, static_cast<int>(logger::level::Trace), static_cast<int>(logger::level::Error));
+        log->setThreshold(static_cast<logger::level>(threshold));
+        STATUS("Server", "log level set to %s by signal=%d", logger::level_to_str(log->getThreshold()).c_str(), signal);
     }
 }
 
@@ -49,12 +87,24 @@ void Server::start() {
     std::size_t thread_count = _config->getThreadCount();
     threads.reserve(thread_count - 2); // (-1 for this thread) + (-1 for the logger) = -2
 
+    pool::setHugePages(_config->getBuffers()->huge_pages);
+    clk::Clock::getInstance()->start(_io_context);
+    timer::Wheel::getInstance()->start(_io_context);
+    RevocationList::getInstance()->start(_io_context, _config->getRevocation()); // load before accepting, tokens are checked from the first request
     asio::co_spawn(_io_context, run(), asio::detached);
+    asio::co_spawn(_io_context, handleSignals(), asio::detached);
+    if(_config->getLoadShedding()->active) {
+        LoadMonitor::getInstance()->start(_io_context, thread_count - 1, _config->getLoadShedding());
+    }
 
     for(std::size_t i = 0; i < thread_count - 2; ++i) {
-        threads.emplace_back([this](){_io_context.run();});
+        threads.emplace_back([this](){
+            _io_context.run();
+            Session::clearPool();
+        });
     }
     _io_context.run();
+    Session::clearPool();
 
     for(auto& thread: threads) {
         thread.join();
@@ -90,7 +140,7 @@ bool Server::isError(const asio::error_code& error) {
 std::unique_ptr<Socket> Server::createSocket()
 {
     if (this->_ssl)
-        return std::make_unique<HTTPSSocket>(this->_io_context, this->_ssl_context);
+        return std::make_unique<Socket>(this->_io_context, this->_ssl_context, _config->getSSL()->kernel_tls);
 
-    return std::make_unique<HTTPSocket>(this->_io_context);
+    return std::make_unique<Socket>(this->_io_context);
 }
@@ -19,6 +19,7 @@ class Server
     Server(const cfg::Config* server_config);
     void start();
     asio::awaitable<void> run();
+    asio::awaitable<void> handleSignals();
 
     private:
     void loadCertificate();
@@ -1,15 +1,59 @@
 #include "Session.h"
+#include "TimerWheel.h"
+
+/* sessions are released on whichever io thread finished them, each thread keeps its own list so none of this locks */
+static thread_local std::vector<std::unique_ptr<Session>> free_sessions;
+
+SessionHandle Session::acquire(const std::function<std::unique_ptr<Socket>()>& create_socket) {
+    if(free_sessions.empty()) {
+        return SessionHandle(new Session(create_socket()));
+    }
+    Session* session = free_sessions.back().release();
+    free_sessions.pop_back();
+    return SessionHandle(session);
+}
+
+void Session::clearPool() {
+    free_sessions.clear();
+}
+
+void SessionRecycler::operator()(Session* session) const noexcept {
+    std::unique_ptr<Session> finished(session);
+    if(free_sessions.size() >= SESSION_POOL_SIZE) {
+        return;
+    }
+    try {
+        finished->sock->reset();
+        free_sessions.push_back(std::move(finished));
+    } catch (const std::exception& error) {
+        DEBUG("Session", "failed to recycle session: %s", error.what());
+    }
+}
 
 asio::awaitable<void> Session::start() {
     sock->storeIP();
+    co_await serve();
+    sock->close(); // only once the deadline is gone, the wheel must never shut down a reused fd
+}
+
+asio::awaitable<void> Session::serve() {
+    timer::Deadline deadline(sock.get(), cfg::Config::getInstance()->getTimeouts());
+    deadline.arm(timer::phase::Handshake);
     asio::error_code error = co_await sock->co_handshake();
     if (error) {
         DEBUG("Session", "handshake failed, error=%d %s", error.value(), error.message().c_str());
         co_return;
     }
 
+    // an idle connection holds no buffers, the transaction takes them from the pool once the request arrives
+    deadline.arm(timer::phase::Idle);
+    if((error = co_await sock->co_wait_readable())) {
+        DEBUG("Session", "wait for request failed, error=%d %s", error.value(), error.message().c_str());
+        co_return;
+    }
+
+    deadline.disarm();
     Transaction txn(sock.get());
     auto pipeline = cfg::Config::getInstance()->getPipeline();
     co_await pipeline->run(&txn);
-    sock->close();
 }
@@ -15,15 +15,33 @@
 #include "config.h"
 #include "Middleware.h"
 
+constexpr std::size_t SESSION_POOL_SIZE = 256; // finished sessions kept per thread, the rest are freed
+
+class Session;
+
+/* returns a finished session to the current thread's free list */
+struct SessionRecycler {
+    void operator()(Session* session) const noexcept;
+};
+using SessionHandle = std::unique_ptr<Session, SessionRecycler>;
+
 class Session
 {
     public:
     Session(std::unique_ptr<Socket>&& sock) : sock(std::move(sock)){};
+
+    /* a recycled session from this thread's free list, or a new one around create_socket() */
+    static SessionHandle acquire(const std::function<std::unique_ptr<Socket>()>& create_socket);
+    static void clearPool(); // frees this thread's sessions, called before the io_context goes away
     
     asio::awaitable<void> start();
     Socket* getSocket() const {return sock.get();}
 
-    std::vector<std::unique_ptr<mw::Middleware>> pipeline;
+    private:
+    asio::awaitable<void> serve();
+
+    public:
+
     std::unique_ptr<Socket> sock;
 };
 
@@ -1,65 +1,252 @@
 #include "Sink.h"
 #include "logger.h"
+#include "Clock.h"
+
+#include <spawn.h>
+#include <sys/wait.h>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <new>
+
+extern char** environ;
 
 using namespace logger;
 
-static std::string get_date() {
-    std::string fmt_time = logger::get_time();
-    return fmt_time.substr(0, fmt_time.find(" "));
+static bool file_exists(const std::string& file_name) {
+    return ::access(file_name.c_str(), F_OK) == 0;
+}
+
+static char* allocate_buffer() {
+    return static_cast<char*>(std::aligned_alloc(SINK_BUFFER_ALIGNMENT, SINK_BUFFER_SIZE));
+}
+
+logger::Compressor::Compressor() {
+    worker_handle = std::thread(&logger::Compressor::run, this);
+}
+
+logger::Compressor::~Compressor() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+        for(const std::string& file_name: pending) { // don't hold up shutdown, leftovers stay uncompressed
+            fprintf(stderr, "shutting down, %s left uncompressed\n", file_name.c_str());
+        }
+        pending.clear();
+    }
+    ready.notify_one();
+    if(worker_handle.joinable()) {
+        worker_handle.join();
+    }
+}
+
+void logger::Compressor::submit(std::string&& file_name) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.push_back(std::move(file_name));
+    }
+    ready.notify_one();
+}
+
+void logger::Compressor::run() {
+    while(true) {
+        std::string file_name;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [this]() { return !running || !pending.empty(); });
+            if(!running) {
+                return;
+            }
+            file_name = std::move(pending.front());
+            pending.pop_front();
+        }
+        compress(file_name);
+    }
+}
+
+void logger::Compressor::compress(const std::string& file_name) {
+    char* argv[] = {const_cast<char*>("gzip"), const_cast<char*>("-f"), const_cast<char*>(file_name.c_str()), (char*)0};
+    pid_t pid;
+    int status;
+    if((status = posix_spawnp(&pid, "gzip", nullptr, nullptr, argv, environ)) != 0) {
+        fprintf(stderr, "failed to spawn gzip for %s: %s\n", file_name.c_str(), strerror(status));
+        return;
+    }
+    while(::waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+    if(!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "gzip failed for %s\n", file_name.c_str());
+    }
 }
 
-logger::FileSink::FileSink(const std::string& path, const std::string& server_name) 
-    :fd(-1), date_today(get_date()), path(path), server_name(server_name)  
+logger::FileSink::FileSink(const std::string& path, const std::string& server_name, const RotationSetting& setting)
+    :fd(-1), path(path), server_name(server_name), setting(setting)
 {
+    char* buffer = allocate_buffer();
+    if(!buffer) {
+        throw std::bad_alloc();
+    }
+    buffers.emplace_back(buffer);
+    if(setting.compress) {
+        compressor = std::make_unique<Compressor>();
+    }
     openFile();
 }
 
 logger::FileSink::~FileSink() {
+    writeBuffers();
     if(fd != -1) {
         ::close(fd);
     }
 }
 
-void logger::FileSink::rotateFile() {
-    if(fd != -1) {
-        ::close(fd);
+std::string logger::FileSink::periodName(std::time_t now) const {
+    std::tm local_time;
+    localtime_r(&now, &local_time);
+    char name[32];
+    std::strftime(name, sizeof(name), setting.interval == rotation::Hourly ? "%Y-%m-%d-%H" : "%Y-%m-%d", &local_time);
+    return name;
+}
+
+std::time_t logger::FileSink::computeNextRotation(std::time_t now) const {
+    if(setting.interval == rotation::None) {
+        return std::numeric_limits<std::time_t>::max();
     }
-    openFile();
+    std::tm boundary;
+    localtime_r(&now, &boundary);
+    boundary.tm_min = 0;
+    boundary.tm_sec = 0;
+    if(setting.interval == rotation::Hourly) {
+        boundary.tm_hour += 1;
+    } else {
+        boundary.tm_hour = 0;
+        boundary.tm_mday += 1;
+    }
+    boundary.tm_isdst = -1; // let mktime resolve dst transitions
+    return std::mktime(&boundary);
 }
 
 void logger::FileSink::openFile() {
-    file_name = path + "/" + server_name + "-" + get_date() + ".log";
-    if ((fd = ::open(file_name.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644))  < 0) {
+    std::time_t now = std::time(nullptr);
+    file_name = path + "/" + server_name + "-" + periodName(now) + ".log";
+    if ((fd = ::open(file_name.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644))  < 0) {
         perror("openFile failed");
     }
-    date_today = get_date();
+    struct stat file_stat;
+    file_bytes = (fd != -1 && fstat(fd, &file_stat) == 0) ? static_cast<std::size_t>(file_stat.st_size) : 0;
+    next_rotation = computeNextRotation(now);
+}
+
+/* a finished period keeps its dated name, a size rotation moves the full file aside as <name>.<part>.log */
+void logger::FileSink::rotateFile(bool period_ended) {
+    if(fd != -1) {
+        ::close(fd);
+        fd = -1;
+    }
+
+    std::string finished = file_name;
+    if(period_ended) {
+        part = 0;
+    } else {
+        std::string base = file_name.substr(0, file_name.size() - 4); // strip ".log"
+        do {
+            finished = base + "." + std::to_string(++part) + ".log";
+        } while(file_exists(finished) || file_exists(finished + ".gz")); // don't clobber parts from before a restart
+        if(::rename(file_name.c_str(), finished.c_str()) < 0) {
+            perror("rotate rename failed");
+            finished.clear();
+        }
+    }
+
+    openFile();
+    if(compressor && !finished.empty() && finished != file_name) {
+        compressor->submit(std::move(finished));
+    }
 }
 
 void logger::FileSink::write(const std::string& log_msg) {
-    if(date_today != get_date()) {
-        rotateFile();
+    const char* data = log_msg.data();
+    std::size_t remaining = log_msg.size();
+    while(remaining > 0) {
+        if(used == SINK_BUFFER_SIZE) {
+            if(++filled == buffers.size()) {
+                char* buffer = buffers.size() < SINK_MAX_BUFFERS ? allocate_buffer() : nullptr;
+                if(buffer) {
+                    buffers.emplace_back(buffer);
+                } else {
+                    --filled;
+                    writeBuffers(); // every buffer is full, or no more could be had, write them now
+                }
+            }
+            used = 0;
+        }
+        std::size_t len = std::min(remaining, SINK_BUFFER_SIZE - used);
+        std::memcpy(buffers[filled].get() + used, data, len);
+        used += len;
+        data += len;
+        remaining -= len;
     }
-    
-    std::size_t bytes_written = 0, msg_size = log_msg.length();
-    while(bytes_written < msg_size) {
-        ssize_t bytes = ::write(fd, log_msg.c_str() + bytes_written, msg_size - bytes_written);
+}
+
+/* writes every buffered byte with a single writev, retrying partial writes */
+void logger::FileSink::writeBuffers() {
+    struct iovec iov[SINK_MAX_BUFFERS];
+    int iov_count = 0;
+    for(std::size_t i = 0; i <= filled && i < buffers.size(); ++i) {
+        std::size_t len = (i == filled) ? used : SINK_BUFFER_SIZE;
+        if(len > 0) {
+            iov[iov_count++] = {buffers[i].get(), len};
+        }
+    }
+    filled = 0;
+    used = 0;
+
+    struct iovec* pending = iov;
+    while(iov_count > 0 && fd != -1) {
+        ssize_t bytes = ::writev(fd, pending, iov_count);
         if(bytes < 0) {
-            perror("write failed");
-            break; 
+            if(errno == EINTR) {
+                continue;
+            }
+            perror("writev failed");
+            break;
+        }
+        file_bytes += bytes;
+        while(iov_count > 0 && static_cast<std::size_t>(bytes) >= pending->iov_len) {
+            bytes -= pending->iov_len;
+            ++pending;
+            --iov_count;
+        }
+        if(iov_count > 0) {
+            pending->iov_base = static_cast<char*>(pending->iov_base) + bytes;
+            pending->iov_len -= bytes;
         }
-        bytes_written += bytes;
+    }
+}
+
+void logger::FileSink::flush() {
+    writeBuffers();
+    if(clk::Clock::getInstance()->now()->seconds >= next_rotation) {
+        rotateFile(true);
+    } else if (setting.max_bytes > 0 && file_bytes >= setting.max_bytes) {
+        rotateFile(false);
     }
 }
 
 void ConsoleSink::write(const std::string& log_msg) {
-    std::size_t msg_len = log_msg.length(), bytes_written = 0;
+    buffer += log_msg;
+}
+
+void ConsoleSink::flush() {
+    std::size_t msg_len = buffer.length(), bytes_written = 0;
     while(bytes_written < msg_len) {
-        ssize_t bytes = ::write(STDOUT_FILENO, log_msg.c_str() + bytes_written, msg_len - bytes_written);
+        ssize_t bytes = ::write(STDOUT_FILENO, buffer.c_str() + bytes_written, msg_len - bytes_written);
         if(bytes < 0) {
             perror("write error: console sink");
             break;
         }
         bytes_written += bytes;
     }
+    buffer.clear();
 }
 
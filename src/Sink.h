@@ -3,21 +3,43 @@
 
 #include <string>
 #include <sstream>
-#include <iomanip>     
-#include <ctime>       
-#include <chrono>      
-#include <fcntl.h>     
-#include <unistd.h>    
-#include <sys/types.h> 
-#include <sys/stat.h>  
-#include <iostream>    
+#include <iomanip>
+#include <ctime>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 namespace logger {
-    
+
+    constexpr std::size_t SINK_BUFFER_SIZE = 256 * 1024;
+    constexpr std::size_t SINK_BUFFER_ALIGNMENT = 4096;
+    constexpr std::size_t SINK_MAX_BUFFERS = 16; // writes inline once this many buffers are full
+
+    enum class rotation {
+        None, Hourly, Daily
+    };
+
+    struct RotationSetting {
+        logger::rotation interval{rotation::Daily};
+        std::size_t max_bytes{0}; // 0 disables size based rotation
+        bool compress{false}; // gzip rotated files on a background thread
+    };
+
     class Sink
     {
         public:
         virtual void write(const std::string& log_msg) = 0;
+        virtual void flush() {} // called by the logger after each batch
         virtual ~Sink() = default;
     };
 
@@ -25,26 +47,68 @@ namespace logger {
     {
         public:
         void write(const std::string& log_msg) override;
+        void flush() override;
+
+        private:
+        std::string buffer;
     };
 
-    class FileSink: public Sink 
+    /* Compresses rotated log files with gzip, one file at a time, off the logger thread */
+    class Compressor
     {
         public:
-        FileSink(const std::string& path, const std::string& server_name);
+        Compressor();
+        ~Compressor();
+        void submit(std::string&& file_name);
+
+        private:
+        std::thread worker_handle;
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::deque<std::string> pending;
+        bool running{true};
+
+        private:
+        void run();
+        static void compress(const std::string& file_name);
+    };
+
+    class FileSink: public Sink
+    {
+        public:
+        FileSink(const std::string& path, const std::string& server_name, const RotationSetting& setting = {});
         ~FileSink();
         void write(const std::string& log_msg) override;
+        void flush() override;
 
         private:
+        struct FreeDeleter {
+            void operator()(char* buffer) const {std::free(buffer);}
+        };
+        using AlignedBuffer = std::unique_ptr<char, FreeDeleter>;
+
         int fd;
-        std::string date_today;
         std::string path;
         std::string server_name;
         std::string file_name;
+        RotationSetting setting;
+
+        std::vector<AlignedBuffer> buffers; // filled in order, buffers[filled] is the one being appended to
+        std::size_t filled{0};
+        std::size_t used{0}; // bytes in buffers[filled]
+
+        std::size_t file_bytes{0};
+        std::time_t next_rotation{0}; // the cached period boundary, compared against time() instead of formatting dates
+        std::size_t part{0}; // suffix for size rotations within one period
+        std::unique_ptr<Compressor> compressor;
 
         private:
         void openFile();
-        void rotateFile();
+        void rotateFile(bool period_ended);
+        void writeBuffers();
+        std::time_t computeNextRotation(std::time_t now) const;
+        std::string periodName(std::time_t now) const;
     };
 };
 
-#endif
\ No newline at end of file
+#endif
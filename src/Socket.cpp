@@ -1,141 +1,152 @@
 #include "Socket.h"
 
-HTTPSocket::HTTPSocket(asio::io_context& io_context) : _socket(io_context) {}
-    
-asio::ip::tcp::socket& HTTPSocket::getRawSocket()
-{
-    return this->_socket;
-}
-
-void HTTPSocket::storeIP() {
-    if(_socket.is_open()) {
-        address = _socket.remote_endpoint().address().to_string();
-    }
-    else {
-        address = "address not available";
+Socket::Socket(asio::io_context& io_context)
+: io_context(io_context), stream(std::in_place_type<PlainStream>, io_context) {}
+
+Socket::Socket(asio::io_context& io_context, asio::ssl::context& ssl_context, bool kernel_tls)
+: io_context(io_context), ssl_context(&ssl_context), kernel_tls(kernel_tls), stream(std::in_place_type<PlainStream>, io_context) {
+    if(kernel_tls) {
+        stream.emplace<KernelStream>(io_context, ssl_context);
+    } else {
+        stream.emplace<TLSStream>(io_context, ssl_context);
     }
 }
 
-void HTTPSocket::handshake(const std::function<void(const asio::error_code&)>& callback)
-{
-    asio::error_code ec;
-    callback(ec);
-}
-
-void HTTPSocket::write(char* buffer, std::size_t buffer_size, const std::function<void(const asio::error_code&, std::size_t)>& callback)
-{
-    asio::async_write(this->_socket, asio::buffer(buffer, buffer_size), 
-    [this, callback](const std::error_code& error, std::size_t bytes)
-    {
-        if(callback) callback(error, bytes);
-    });
-}
-
-void HTTPSocket::read(char* buffer, std::size_t buffer_size, const std::function<void(const asio::error_code&, std::size_t)>& callback)
-{
-    this->_socket.async_read_some(asio::buffer(buffer, buffer_size),    
-    [this, callback](const asio::error_code& error, std::size_t bytes)
-    {
-        if(callback) callback(error, bytes);
-    });
+asio::ip::tcp::socket& Socket::getRawSocket() {
+    return std::visit([](auto& s) -> asio::ip::tcp::socket& {
+        if constexpr (std::is_same_v<std::decay_t<decltype(s)>, PlainStream>) {
+            return s;
+        } else {
+            return s.next_layer();
+        }
+    }, stream);
 }
 
-asio::awaitable<asio::error_code> HTTPSocket::co_handshake() {
-    co_return asio::error_code{};
-}
-
-asio::awaitable<std::tuple<asio::error_code, std::size_t>> HTTPSocket::co_read(char* buffer, std::size_t size) {
-    auto [ec, bytes_read] = co_await _socket.async_read_some(asio::buffer(buffer, size), asio::as_tuple(asio::use_awaitable));
-    co_return std::make_tuple(ec, bytes_read);
-}
-
-asio::awaitable<std::tuple<asio::error_code, std::size_t>> HTTPSocket::co_write(const char* buffer, std::size_t size) {
-    auto [ec, bytes_written] = co_await asio::async_write(_socket, asio::buffer(buffer, size), asio::as_tuple(asio::use_awaitable));
-    co_return std::make_tuple(ec, bytes_written);
-}
-
-void HTTPSocket::close()
-{
-    this->_socket.close();
-}
-
-HTTPSocket::~HTTPSocket()
-{
-    if(this->_socket.is_open())
-    {
-        this->_socket.close();
+SSL* Socket::nativeTLS() {
+    if(auto* tls = std::get_if<TLSStream>(&stream)) {
+        return tls->native_handle();
+    }
+    if(auto* kernel = std::get_if<KernelStream>(&stream)) {
+        return kernel->native_handle();
     }
+    return nullptr;
 }
 
-/*////// HTTPS Socket //////*/
-
-HTTPSSocket::HTTPSSocket(asio::io_context& io_context, asio::ssl::context& ssl_context): _socket(io_context, ssl_context)  {}
-
-void HTTPSSocket::storeIP() {
-    if(_socket.next_layer().is_open()) {
-        address = _socket.next_layer().remote_endpoint().address().to_string();
+void Socket::storeIP() {
+    if(getRawSocket().is_open()) {
+        address = getRawSocket().remote_endpoint().address().to_string();
     }
     else {
         address = "address not available";
     }
 }
 
-asio::ip::tcp::socket& HTTPSSocket::getRawSocket()
-{
-    return this->_socket.next_layer();
+asio::awaitable<asio::error_code> Socket::co_handshake() {
+    if(auto* tls = std::get_if<TLSStream>(&stream)) {
+        auto [ec] = co_await tls->async_handshake(asio::ssl::stream_base::server, asio::as_tuple(asio::use_awaitable));
+        co_return ec;
+    }
+    if(auto* kernel = std::get_if<KernelStream>(&stream)) {
+        co_return co_await kernel->co_handshake();
+    }
+    co_return asio::error_code{};
 }
 
-void HTTPSSocket::handshake(const std::function<void(const std::error_code& error)>& callback)
-{
-    this->_socket.async_handshake(asio::ssl::stream_base::server,
-    [this, callback](const asio::error_code& error)
-    {
-        if(callback) callback(error);
-    });
+/*
+ * Completes once a read won't block, without a buffer. An asio tls stream returns at once, the handshake reads
+ * ahead and the request may already sit decrypted in asio's engine where the socket can't see it.
+ */
+asio::awaitable<asio::error_code> Socket::co_wait_readable() {
+    if(auto* plain = std::get_if<PlainStream>(&stream)) {
+        auto [ec] = co_await plain->async_wait(asio::ip::tcp::socket::wait_read, asio::as_tuple(asio::use_awaitable));
+        co_return ec;
+    }
+    if(auto* kernel = std::get_if<KernelStream>(&stream)) {
+        co_return co_await kernel->co_wait_readable();
+    }
+    co_return asio::error_code{};
 }
 
-void HTTPSSocket::read(char* buffer, std::size_t buffer_size, const std::function<void(const asio::error_code&, std::size_t)>& callback)
-{
-    this->_socket.async_read_some(asio::buffer(buffer, buffer_size),    
-    [this, callback](const asio::error_code& error, std::size_t bytes)
-    {
-        if(callback) callback(error, bytes);
-    });
+Socket::IOResult Socket::co_read(char* buffer, std::size_t size) {
+    return std::visit([buffer, size](auto& s) -> IOResult {
+        if constexpr (std::is_same_v<std::decay_t<decltype(s)>, KernelStream>) {
+            return s.co_read(buffer, size);
+        } else {
+            return s.async_read_some(asio::buffer(buffer, size), asio::as_tuple(asio::use_awaitable));
+        }
+    }, stream);
 }
 
-void HTTPSSocket::write(char* buffer, std::size_t buffer_size, const std::function<void(const asio::error_code&, std::size_t)>& callback)
-{
-    asio::async_write(this->_socket, asio::buffer(buffer, buffer_size), 
-    [this, callback](const std::error_code& error, std::size_t bytes)
-    {
-        if(callback) callback(error, bytes);
-    });
+Socket::IOResult Socket::co_write(const char* buffer, std::size_t size) {
+    if(SSL* ssl = nativeTLS()) {
+        sizer.prepare(ssl, size);
+    }
+    return std::visit([buffer, size](auto& s) -> IOResult {
+        if constexpr (std::is_same_v<std::decay_t<decltype(s)>, KernelStream>) {
+            return s.co_write(buffer, size);
+        } else {
+            return asio::async_write(s, asio::buffer(buffer, size), asio::as_tuple(asio::use_awaitable));
+        }
+    }, stream);
+}
+
+/* 
+ * The ssl stream encrypts one buffer per record, so a gather would still go out as a record per buffer.
+ * Small responses are copied into a single record instead, larger ones are written as is.
+ */
+Socket::IOResult Socket::co_write(std::span<const asio::const_buffer> buffers) {
+    SSL* ssl = nativeTLS();
+    std::size_t total = asio::buffer_size(buffers);
+    if(ssl && buffers.size() > 1 && total <= TLS_RECORD_SIZE) {
+        record = pool::acquire(total);
+        asio::buffer_copy(asio::buffer(record.data(), record.size()), buffers);
+        return co_write(record.data(), record.size());
+    }
+    if(ssl) {
+        sizer.prepare(ssl, total);
+    }
+    return std::visit([buffers](auto& s) -> IOResult {
+        if constexpr (std::is_same_v<std::decay_t<decltype(s)>, KernelStream>) {
+            return s.co_write(buffers);
+        } else {
+            return asio::async_write(s, buffers, asio::as_tuple(asio::use_awaitable));
+        }
+    }, stream);
 }
 
-asio::awaitable<asio::error_code> HTTPSSocket::co_handshake() {
-    auto [ec] = co_await this->_socket.async_handshake(asio::ssl::stream_base::server, asio::as_tuple(asio::use_awaitable));
-    co_return ec;
+static Socket::IOResult unsupported() {
+    co_return std::make_tuple(asio::error_code(asio::error::operation_not_supported), std::size_t{0});
 }
 
-asio::awaitable<std::tuple<asio::error_code, std::size_t>> HTTPSSocket::co_read(char *buffer, std::size_t buffer_size) {
-    auto [ec, bytes_read]= co_await _socket.async_read_some(asio::buffer(buffer, buffer_size), asio::as_tuple(asio::use_awaitable));
-    co_return std::make_tuple(ec, bytes_read);
+Socket::IOResult Socket::co_sendfile(int fd, off_t offset, std::size_t size) {
+    if(auto* kernel = std::get_if<KernelStream>(&stream); kernel && kernel->kernelSend()) {
+        return kernel->co_sendfile(fd, offset, size);
+    }
+    return unsupported();
 }
 
-asio::awaitable<std::tuple<asio::error_code, std::size_t>> HTTPSSocket::co_write(const char *buffer, std::size_t buffer_size) {
-    auto [ec, bytes_written] = co_await asio::async_write(_socket, asio::buffer(buffer, buffer_size), asio::as_tuple(asio::use_awaitable));
-    co_return std::make_tuple(ec, bytes_written);
+bool Socket::canSendFile() const {
+    auto* kernel = std::get_if<KernelStream>(&stream);
+    return kernel && kernel->kernelSend();
 }
 
-void HTTPSSocket::close()
-{
-    this->_socket.next_layer().close();
+void Socket::close() {
+    if(SSL* ssl = nativeTLS()) {
+        // no close_notify is exchanged, without this openssl drops the session from the cache when the stream is freed
+        SSL_set_shutdown(ssl, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+    }
+    getRawSocket().close();
 }
 
-HTTPSSocket::~HTTPSSocket()
-{
-    if(this->_socket.next_layer().is_open())
-    {
-        this->_socket.next_layer().close();
+/* a closed tcp socket can be accepted into again, asio's ssl engine keeps its own bio pair and handshake state that SSL_clear can't reset, so the stream is rebuilt in place */
+void Socket::reset() {
+    asio::error_code ec;
+    getRawSocket().close(ec);
+    record = {};
+    sizer.reset();
+    if(kernel_tls) {
+        stream.emplace<KernelStream>(io_context, *ssl_context);
+    } else if(ssl_context) {
+        stream.emplace<TLSStream>(io_context, *ssl_context);
     }
-}
\ No newline at end of file
+}
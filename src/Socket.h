@@ -6,11 +6,16 @@
 #include <asio/use_awaitable.hpp>
 #include <asio/ssl.hpp>
 #include <vector>
+#include <variant>
+#include <span>
 #include "logger.h"
+#include "BufferPool.h"
+#include "TLS.h"
 
 /* Estimated BDP for typical network conditions, e.g.) RTT=20 ms, BW=100-200 Mbps*/
 #define BUFFER_SIZE 262144
 #define HEADER_SIZE 8192
+#define TLS_RECORD_SIZE 16384
 
 struct TransferState {
     long total_bytes{0};         
@@ -21,69 +26,55 @@ struct TransferState {
     static constexpr auto RETRY_DELAY = std::chrono::milliseconds(100);
 };
 
-class Socket
-{
-    public:
-    virtual void storeIP() = 0;
-    virtual void handshake(const std::function<void(const asio::error_code&)>& callback) = 0;
-    virtual void read(char* buffer, std::size_t buffer_size, const std::function<void(const asio::error_code&, std::size_t)>& callback = nullptr) = 0;
-    virtual void write(char* buffer, std::size_t buffer_size, const std::function<void(const asio::error_code&, std::size_t)>& callback = nullptr) = 0;
-    
-    virtual asio::awaitable<asio::error_code> co_handshake() = 0;
-    virtual asio::awaitable<std::tuple<asio::error_code, std::size_t>> co_read(char* buffer, std::size_t size) = 0;
-    virtual asio::awaitable<std::tuple<asio::error_code, std::size_t>> co_write(const char* buffer, std::size_t size) = 0;
-
-    std::string getIP() const  { return address; }
-    virtual asio::ip::tcp::socket& getRawSocket() = 0;
-    virtual void close() = 0;
-    virtual ~Socket() = default;
-    protected:
-    std::string address;
+namespace timer {
+    class Deadline;
 };
 
-class HTTPSocket: public Socket
+/*
+ * A plain or TLS connection, the stream type is fixed at construction and dispatched with std::visit. TLS runs through
+ * asio's ssl stream, or with kernel tls enabled through openssl directly on the socket.
+ * Reads and writes hand back asio's awaitable for the operation itself, no virtual call and no wrapping coroutine frame.
+ */
+class Socket
 {
     public:
-    HTTPSocket(asio::io_context& io_context);
-    ~HTTPSocket();
+    using PlainStream = asio::ip::tcp::socket;
+    using TLSStream = asio::ssl::stream<asio::ip::tcp::socket>;
+    using KernelStream = tls::KernelStream;
+    using IOResult = asio::awaitable<std::tuple<asio::error_code, std::size_t>>;
 
-    asio::awaitable<asio::error_code> co_handshake() override;
-    asio::awaitable<std::tuple<asio::error_code, std::size_t>> co_read(char* buffer, std::size_t size) override;
-    asio::awaitable<std::tuple<asio::error_code, std::size_t>> co_write(const char* buffer, std::size_t size) override;
-   
-    void handshake(const std::function<void(const asio::error_code&)>& callback) override;
-    void read(char* buffer, std::size_t buffer_size, const std::function<void(const asio::error_code&, std::size_t)>& callback = nullptr) override;
-    void write(char* buffer, std::size_t buffer_size, const std::function<void(const asio::error_code&, std::size_t)>& callback = nullptr) override;
-    
-    void storeIP() override;
-    void close() override;
-    asio::ip::tcp::socket& getRawSocket() override;
-    
-    private:
-    asio::ip::tcp::socket _socket;
-};
+    explicit Socket(asio::io_context& io_context);
+    Socket(asio::io_context& io_context, asio::ssl::context& ssl_context, bool kernel_tls = false);
 
-class HTTPSSocket : public Socket
-{
-    public:
-    HTTPSSocket(asio::io_context& io_context, asio::ssl::context& ssl_context);
-    ~HTTPSSocket();
+    asio::awaitable<asio::error_code> co_handshake();
+    asio::awaitable<asio::error_code> co_wait_readable();
+    IOResult co_read(char* buffer, std::size_t size);
+    IOResult co_write(const char* buffer, std::size_t size);
+    IOResult co_write(std::span<const asio::const_buffer> buffers);
+    IOResult co_sendfile(int fd, off_t offset, std::size_t size); // may send less than size, only if canSendFile()
+    bool canSendFile() const; // the kernel encrypts this connection's records
 
-    asio::awaitable<asio::error_code> co_handshake() override;
-    asio::awaitable<std::tuple<asio::error_code, std::size_t>> co_read(char* buffer, std::size_t buffer_size) override;
-    asio::awaitable<std::tuple<asio::error_code, std::size_t>> co_write(const char* buffer, std::size_t buffer_size) override;
-    
-    void handshake(const std::function<void(const asio::error_code&)>& callback) override;
-    void read(char* buffer, std::size_t buffer_size, const std::function<void(const asio::error_code&, std::size_t)>& callback = nullptr) override;
-    void write(char* buffer, std::size_t buffer_size, const std::function<void(const asio::error_code&, std::size_t)>& callback = nullptr) override;
-    
-    void storeIP() override;
+    void storeIP();
+    std::string getIP() const { return address; }
+    asio::ip::tcp::socket& getRawSocket();
+    bool isTLS() const {return ssl_context != nullptr;}
     void close();
-    asio::ip::tcp::socket& getRawSocket() override;
-    
+    void reset(); // closes the connection and readies the socket for another accept
+    void setDeadline(timer::Deadline* deadline) {this->deadline = deadline;}
+    timer::Deadline* getDeadline() const {return deadline;}
+
     private:
-    asio::ssl::stream<asio::ip::tcp::socket> _socket;
+    asio::io_context& io_context;
+    asio::ssl::context* ssl_context{nullptr};
+    bool kernel_tls{false};
+    std::variant<PlainStream, TLSStream, KernelStream> stream;
+    std::string address;
+    pool::Lease record; // the last coalesced tls record, must outlive the write it was sent with
+    timer::Deadline* deadline{nullptr}; // set while a session is serving the connection
+    tls::RecordSizer sizer;
+
+    private:
+    SSL* nativeTLS(); // nullptr for a plain connection
 };
 
 #endif
-
@@ -35,7 +35,12 @@ asio::awaitable<void> FileStreamer::stream(Socket* sock) {
     if(filefd == -1) {
         openFile();
     }
+    if(sock->canSendFile()) {
+        co_await sendFile(sock);
+        co_return;
+    }
     
+    buffer = pool::acquire(BUFFER_SIZE);
     http::io::WriteStatus result;
     std::size_t bytes_sent(0);
     while (bytes_sent < file_len) {
@@ -49,21 +54,60 @@ asio::awaitable<void> FileStreamer::stream(Socket* sock) {
             throw http::HTTPException(http::code::Internal_Server_Error, std::format("Failed reading file {}", file_path));
         }
 
-        std::span<const char> write_buffer(buffer.data(), bytes_to_write);
-        result = co_await http::io::co_write_all(sock, write_buffer);
+        std::array<asio::const_buffer, 2> write_buffers{asio::buffer(header.data(), header.size()), asio::buffer(buffer.data(), bytes_to_write)};
+        result = co_await http::io::co_write_all(sock, std::span<const asio::const_buffer>(write_buffers));
         if(!http::is_success_code(result.status)) {
             throw http::HTTPException(result.status, std::move(result.message));
         }
-        bytes_sent += result.bytes;
+        bytes_sent += result.bytes - header.size();
+        bytes_streamed += result.bytes;
+        header = {};
+    }
+    if(!header.empty()) { // nothing was read, the header still goes out
+        result = co_await http::io::co_write_all(sock, header);
+        if(!http::is_success_code(result.status)) {
+            throw http::HTTPException(result.status, std::move(result.message));
+        }
+        bytes_streamed += result.bytes;
+        header = {};
+    }
+}
+
+/* the kernel encrypts the records, the file goes out from the page cache without a copy through user space */
+asio::awaitable<void> FileStreamer::sendFile(Socket* sock) {
+    http::io::WriteStatus result;
+    if(!header.empty()) {
+        result = co_await http::io::co_write_all(sock, header);
+        if(!http::is_success_code(result.status)) {
+            throw http::HTTPException(result.status, std::move(result.message));
+        }
+        bytes_streamed += result.bytes;
+        header = {};
+    }
+    result = co_await http::io::co_sendfile_all(sock, filefd, 0, static_cast<std::size_t>(file_len));
+    bytes_streamed += result.bytes;
+    if(!http::is_success_code(result.status)) {
+        throw http::HTTPException(result.status, std::move(result.message));
+    }
+}
+
+static void close_fd(int& fd) {
+    if(fd != -1) {
+        close(fd);
+        fd = -1;
     }
-    bytes_streamed = bytes_sent;
 }
 
 ScriptStreamer::~ScriptStreamer() {
-    close(stdin_pipe[0]);
-    close(stdin_pipe[1]);
-    close(stdout_pipe[0]);
-    close(stdout_pipe[1]);
+    close_fd(stdin_pipe[0]);
+    close_fd(stdin_pipe[1]);
+    close_fd(stdout_pipe[0]);
+    close_fd(stdout_pipe[1]);
+    if(pid > 0) {
+        kill(pid, SIGKILL);
+        while(waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+        DEBUG("Script Streamer", "killed script=%s pid=%d", script_path.c_str(), pid);
+    }
 }
 
 extern char** environ;
@@ -93,8 +137,8 @@ void ScriptStreamer::spawnProcess() {
         std::format("failed to launch script={} with posix spawn, error={} ({})", script_path.c_str(), status, strerror(status)));
     }
     posix_spawn_file_actions_destroy(&actions);
-    close(stdin_pipe[0]);
-    close(stdout_pipe[1]);
+    close_fd(stdin_pipe[0]);
+    close_fd(stdout_pipe[1]);
 }
 
 void ScriptStreamer::spawn() {
@@ -111,16 +155,17 @@ void ScriptStreamer::spawn() {
         std::format("Failed to write args to script {} (pid={}), errno={}, ({})", 
         script_path.c_str(), pid, errno, strerror(errno)));
     }
-    close(stdin_pipe[1]); // signal eof to child
+    close_fd(stdin_pipe[1]); // signal eof to child
 }
 
 asio::awaitable<void> ScriptStreamer::stream(Socket* sock) {
     spawn();
     
     asio::posix::stream_descriptor reader(sock->getRawSocket().get_executor(), stdout_pipe[0]);
+    stdout_pipe[0] = -1; // the reader closes it
     asio::error_code read_ec;
     std::size_t bytes_read(0), bytes_sent(0);
-    std::vector<char> buffer(BUFFER_SIZE);
+    pool::Lease buffer = pool::acquire(BUFFER_SIZE);
     http::io::WriteStatus result;
 
     while(true) {
@@ -129,6 +174,10 @@ asio::awaitable<void> ScriptStreamer::stream(Socket* sock) {
             bytes_sent += bytes_read;
             break;
         } 
+        if(read_ec == asio::error::operation_aborted) {
+            throw http::HTTPException(http::code::Client_Closed_Request, 
+            std::format("script={} pid={} cancelled, the client went away", script_path, pid));
+        }
         if(read_ec && read_ec != asio::error::eof) {
             throw http::HTTPException(http::code::Internal_Server_Error, 
             std::format("Failed to read response from subprocess={}, pid={}, asio::error={}, ({})", 
@@ -148,6 +197,7 @@ asio::awaitable<void> ScriptStreamer::stream(Socket* sock) {
         bytes_sent += result.bytes;
     }
     waitpid(pid, &status, 0);
+    pid = -1;
     bytes_streamed = bytes_sent;
     co_return;
 }
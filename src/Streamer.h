@@ -3,6 +3,7 @@
 
 #include <asio/awaitable.hpp>
 #include <functional>
+#include <signal.h>
 #include <spawn.h>
 #include <sys/wait.h>
 
@@ -10,6 +11,7 @@
 #include "logger_macros.h"
 #include "Transaction.h"
 #include "Socket.h"
+#include "BufferPool.h"
 
 
 class Streamer
@@ -37,16 +39,19 @@ class FileStreamer: public Streamer
 {
     public:
     FileStreamer(const std::string& file_path): 
-    buffer(BUFFER_SIZE, 0), file_path(file_path), filefd(-1) {openFile();}
+    file_path(file_path), filefd(-1) {openFile();}
     ~FileStreamer() override;
     long getFileSize() {return file_len;}
+    void prepend(std::span<const char> header) {this->header = header;} // sent with the first chunk, in one write
     asio::awaitable<void> stream(Socket*) override;
 
     private:
     void openFile();
+    asio::awaitable<void> sendFile(Socket* sock);
 
     private:
-    std::vector<char> buffer;
+    pool::Lease buffer; // only taken when the file is copied through user space
+    std::span<const char> header;
     std::string file_path;
     long file_len;
     int filefd;
@@ -58,7 +63,7 @@ class ScriptStreamer: public Streamer
     ScriptStreamer(const std::string& script_path, const std::string& stdin_data, 
     std::function<asio::awaitable<void>(const char*, std::size_t)> chunk_callback = nullptr) 
     : script_path(script_path), stdin_data(stdin_data), chunk_callback(chunk_callback) {} 
-    ~ScriptStreamer();
+    ~ScriptStreamer(); // kills and reaps the child if the stream didn't finish, e.g. the client went away
 
     asio::awaitable<void> stream(Socket* sock) override;
 
@@ -70,10 +75,10 @@ class ScriptStreamer: public Streamer
     const std::string& script_path;
     const std::string& stdin_data;
     std::function<asio::awaitable<void>(const char*, std::size_t)> chunk_callback;
-    int stdin_pipe[2];
-    int stdout_pipe[2];
+    int stdin_pipe[2]{-1, -1};
+    int stdout_pipe[2]{-1, -1}; // -1 once closed or handed off
     int status;
-    pid_t pid;
+    pid_t pid{-1}; // -1 once reaped
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,305 @@
+#include "TLS.h"
+#include "config.h"
+#include "logger_macros.h"
+
+#include <algorithm>
+#include <cstring>
+#include <openssl/core_names.h>
+#include <openssl/err.h>
+#include <openssl/rand.h>
+
+using namespace tls;
+
+namespace {
+    struct RecordProfile {
+        bool dynamic{false};
+        std::size_t small{MAX_RECORD_SIZE};
+        std::size_t boost_after{0};
+        std::chrono::milliseconds idle_reset{0};
+    };
+};
+
+static RecordProfile records;
+static const unsigned char SESSION_ID_CONTEXT[] = "cgi-web-server";
+
+TicketKeys TicketKeys::INSTANCE;
+
+TicketKeys* TicketKeys::getInstance() {
+    return &TicketKeys::INSTANCE;
+}
+
+void tls::configure(asio::ssl::context& context, const cfg::SSLConfig* setting) {
+    SSL_CTX* ctx = context.native_handle();
+    SSL_CTX_set_min_proto_version(ctx, setting->min_version == "1.3" ? TLS1_3_VERSION : TLS1_2_VERSION);
+    SSL_CTX_set_max_proto_version(ctx, TLS1_3_VERSION);
+    SSL_CTX_set_options(ctx, SSL_OP_CIPHER_SERVER_PREFERENCE | SSL_OP_NO_RENEGOTIATION);
+
+    if(SSL_CTX_set_cipher_list(ctx, setting->ciphers.c_str()) != 1) {
+        FATAL("TLS", "invalid tls 1.2 cipher list '%s'", setting->ciphers.c_str());
+    }
+    if(SSL_CTX_set_ciphersuites(ctx, setting->ciphersuites.c_str()) != 1) {
+        FATAL("TLS", "invalid tls 1.3 ciphersuites '%s'", setting->ciphersuites.c_str());
+    }
+    if(SSL_CTX_set1_groups_list(ctx, setting->curves.c_str()) != 1) {
+        FATAL("TLS", "invalid curves '%s'", setting->curves.c_str());
+    }
+
+    // full handshakes are the expensive part, let returning clients resume from the cache or a ticket
+    SSL_CTX_set_session_id_context(ctx, SESSION_ID_CONTEXT, sizeof(SESSION_ID_CONTEXT) - 1);
+    SSL_CTX_set_timeout(ctx, std::max(1, setting->session_timeout_ms / 1000));
+    if(setting->session_cache_size > 0) {
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+        SSL_CTX_sess_set_cache_size(ctx, setting->session_cache_size);
+    } else {
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+    }
+    if(setting->tickets) {
+        TicketKeys::getInstance()->configure(std::chrono::milliseconds(setting->ticket_rotation_ms), std::chrono::milliseconds(setting->session_timeout_ms));
+        SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, TicketKeys::callback);
+    } else {
+        SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET); // tls 1.3 falls back to stateful tickets from the cache
+    }
+
+    records.dynamic = setting->dynamic_records;
+    records.small = std::clamp(setting->small_record_size, MIN_RECORD_SIZE, MAX_RECORD_SIZE);
+    records.boost_after = setting->record_boost_bytes;
+    records.idle_reset = std::chrono::milliseconds(setting->record_idle_ms);
+
+    DEBUG("TLS", "min_version=%s curves=%s session_cache=%ld session_timeout=%dms tickets=%s rotation=%dms dynamic_records=%s [small=%zu boost_after=%zu idle=%dms]",
+        setting->min_version.c_str(), setting->curves.c_str(), setting->session_cache_size, setting->session_timeout_ms, setting->tickets ? "on" : "off",
+        setting->ticket_rotation_ms, records.dynamic ? "on" : "off", records.small, records.boost_after, setting->record_idle_ms);
+
+#ifdef OPENSSL_NO_KTLS
+    if(setting->kernel_tls) {
+        WARN("TLS", "kernel tls requested but openssl was built without it, records are encrypted in user space");
+    }
+#endif
+}
+
+void RecordSizer::prepare(SSL* ssl, std::size_t bytes) {
+    if(!records.dynamic) {
+        return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if(sent && now - last_write > records.idle_reset) {
+        sent = 0;
+    }
+    std::size_t target = sent < records.boost_after ? records.small : MAX_RECORD_SIZE;
+    if(target != current) {
+        SSL_set_max_send_fragment(ssl, target);
+        current = target;
+    }
+    sent += bytes;
+    last_write = now;
+}
+
+KernelStream::KernelStream(asio::io_context& io_context, asio::ssl::context& context)
+: socket(io_context), ssl(SSL_new(context.native_handle())) {
+    if(!ssl) {
+        throw std::bad_alloc();
+    }
+    SSL_set_options(ssl, SSL_OP_ENABLE_KTLS); // only takes effect on a socket bio, ignored if openssl or the kernel lack support
+}
+
+KernelStream::~KernelStream() {
+    SSL_free(ssl); // frees the bio, which leaves the fd to the socket
+}
+
+/* the socket is only accepted into after construction, so the bio is attached here */
+asio::awaitable<asio::error_code> KernelStream::co_handshake() {
+    asio::error_code ec;
+    socket.non_blocking(true, ec);
+    BIO* bio = ec ? nullptr : BIO_new_socket(socket.native_handle(), BIO_NOCLOSE);
+    if(!bio) {
+        co_return ec ? ec : asio::error::no_memory;
+    }
+    SSL_set_bio(ssl, bio, bio);
+    SSL_set_accept_state(ssl);
+    while(true) {
+        ERR_clear_error();
+        int ret = SSL_do_handshake(ssl);
+        if(ret == 1) {
+            TRACE("TLS", "handshake done, kernel tls %s", kernelSend() ? "sending" : "unavailable");
+            co_return asio::error_code{};
+        }
+        if((ec = co_await wait(ret))) {
+            co_return ec;
+        }
+    }
+}
+
+/* openssl doesn't read ahead on a socket bio, anything not yet decrypted is still visible to the socket */
+asio::awaitable<asio::error_code> KernelStream::co_wait_readable() {
+    if(SSL_has_pending(ssl)) {
+        co_return asio::error_code{};
+    }
+    auto [ec] = co_await socket.async_wait(asio::ip::tcp::socket::wait_read, asio::as_tuple(asio::use_awaitable));
+    co_return ec;
+}
+
+KernelStream::IOResult KernelStream::co_read(char* buffer, std::size_t size) {
+    while(true) {
+        ERR_clear_error();
+        std::size_t bytes = 0;
+        int ret = SSL_read_ex(ssl, buffer, size, &bytes);
+        if(ret == 1) {
+            co_return std::make_tuple(asio::error_code{}, bytes);
+        }
+        if(auto ec = co_await wait(ret)) {
+            co_return std::make_tuple(ec, std::size_t{0});
+        }
+    }
+}
+
+/* a write that would block is retried with the same arguments, as openssl requires */
+KernelStream::IOResult KernelStream::co_write(const char* buffer, std::size_t size) {
+    std::size_t written = 0;
+    while(written < size) {
+        ERR_clear_error();
+        std::size_t bytes = 0;
+        int ret = SSL_write_ex(ssl, buffer + written, size - written, &bytes);
+        if(ret == 1) {
+            written += bytes;
+            continue;
+        }
+        if(auto ec = co_await wait(ret)) {
+            co_return std::make_tuple(ec, written);
+        }
+    }
+    co_return std::make_tuple(asio::error_code{}, written);
+}
+
+KernelStream::IOResult KernelStream::co_write(std::span<const asio::const_buffer> buffers) {
+    std::size_t written = 0;
+    for(const auto& buffer: buffers) {
+        auto [ec, bytes] = co_await co_write(static_cast<const char*>(buffer.data()), buffer.size());
+        written += bytes;
+        if(ec) {
+            co_return std::make_tuple(ec, written);
+        }
+    }
+    co_return std::make_tuple(asio::error_code{}, written);
+}
+
+KernelStream::IOResult KernelStream::co_sendfile(int fd, off_t offset, std::size_t size) {
+    while(true) {
+        ERR_clear_error();
+        ossl_ssize_t sent = SSL_sendfile(ssl, fd, offset, size, 0);
+        if(sent >= 0) {
+            co_return std::make_tuple(asio::error_code{}, static_cast<std::size_t>(sent));
+        }
+        if(auto ec = co_await wait(static_cast<int>(sent))) {
+            co_return std::make_tuple(ec, std::size_t{0});
+        }
+    }
+}
+
+bool KernelStream::kernelSend() const {
+    BIO* wbio = SSL_get_wbio(ssl);
+    return wbio && BIO_get_ktls_send(wbio);
+}
+
+static asio::awaitable<asio::error_code> wait_ready(asio::ip::tcp::socket& socket, asio::ip::tcp::socket::wait_type direction) {
+    auto [ec] = co_await socket.async_wait(direction, asio::as_tuple(asio::use_awaitable));
+    co_return ec;
+}
+
+static asio::awaitable<asio::error_code> failed(asio::error_code ec) {
+    co_return ec;
+}
+
+/* not a coroutine, errno and openssl's error queue are read before anything else can touch them */
+asio::awaitable<asio::error_code> KernelStream::wait(int ret) {
+    int error = SSL_get_error(ssl, ret);
+    int sys_error = errno;
+    if(error == SSL_ERROR_WANT_READ) {
+        return wait_ready(socket, asio::ip::tcp::socket::wait_read);
+    }
+    if(error == SSL_ERROR_WANT_WRITE) {
+        return wait_ready(socket, asio::ip::tcp::socket::wait_write);
+    }
+
+    asio::error_code ec;
+    unsigned long ssl_error = ERR_get_error();
+    if(error == SSL_ERROR_ZERO_RETURN || (error == SSL_ERROR_SYSCALL && sys_error == 0) || 
+       ERR_GET_REASON(ssl_error) == SSL_R_UNEXPECTED_EOF_WHILE_READING) {
+        ec = asio::error::eof;
+    } else if(error == SSL_ERROR_SYSCALL) {
+        ec = asio::error_code(sys_error, asio::error::get_system_category());
+    } else {
+        ec = asio::error_code(static_cast<int>(ssl_error), asio::error::get_ssl_category());
+    }
+    return failed(ec);
+}
+
+void TicketKeys::configure(std::chrono::milliseconds rotation, std::chrono::milliseconds lifetime) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->rotation = rotation;
+    this->lifetime = lifetime;
+    keys.clear();
+    rotate(std::chrono::steady_clock::now());
+}
+
+/* mutex held, a rotation of 0 keeps the first key for the life of the process */
+void TicketKeys::rotate(std::chrono::steady_clock::time_point now) {
+    if(keys.empty() || (rotation.count() > 0 && now - keys.front().created >= rotation)) {
+        Key key;
+        if(RAND_bytes(key.name, sizeof(key.name)) != 1 || RAND_bytes(key.aes_key, sizeof(key.aes_key)) != 1 ||
+           RAND_bytes(key.hmac_key, sizeof(key.hmac_key)) != 1) {
+            ERROR("TLS", "failed to generate a session ticket key, keeping the current one");
+            return;
+        }
+        key.created = now;
+        keys.push_front(key);
+        TRACE("TLS", "rotated session ticket key, %zu keys held", keys.size());
+    }
+    // a key seals tickets until it's replaced, the last of which stay valid for the session lifetime
+    while(keys.size() > 1 && now - keys.back().created > rotation + lifetime) {
+        keys.pop_back();
+    }
+}
+
+static int init_mac(EVP_MAC_CTX* mac, unsigned char* hmac_key, std::size_t length) {
+    OSSL_PARAM params[] = {
+        OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, hmac_key, length),
+        OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, const_cast<char*>("SHA256"), 0),
+        OSSL_PARAM_construct_end()
+    };
+    return EVP_MAC_CTX_set_params(mac, params);
+}
+
+int TicketKeys::seal(unsigned char* key_name, unsigned char* iv, EVP_CIPHER_CTX* cipher, EVP_MAC_CTX* mac) {
+    std::lock_guard<std::mutex> lock(mutex);
+    rotate(std::chrono::steady_clock::now());
+    Key& key = keys.front();
+    if(RAND_bytes(iv, EVP_CIPHER_get_iv_length(EVP_aes_256_cbc())) != 1) {
+        return -1;
+    }
+    std::memcpy(key_name, key.name, sizeof(key.name));
+    if(EVP_EncryptInit_ex(cipher, EVP_aes_256_cbc(), nullptr, key.aes_key, iv) != 1 || init_mac(mac, key.hmac_key, sizeof(key.hmac_key)) != 1) {
+        return -1;
+    }
+    return 1;
+}
+
+int TicketKeys::open(const unsigned char* key_name, unsigned char* iv, EVP_CIPHER_CTX* cipher, EVP_MAC_CTX* mac) {
+    std::lock_guard<std::mutex> lock(mutex);
+    rotate(std::chrono::steady_clock::now());
+    auto key = std::find_if(keys.begin(), keys.end(), [key_name](const Key& k) {
+        return std::memcmp(k.name, key_name, sizeof(k.name)) == 0;
+    });
+    if(key == keys.end()) {
+        return 0; // unknown or retired key, fall back to a full handshake
+    }
+    if(EVP_DecryptInit_ex(cipher, EVP_aes_256_cbc(), nullptr, key->aes_key, iv) != 1 || init_mac(mac, key->hmac_key, sizeof(key->hmac_key)) != 1) {
+        return -1;
+    }
+    return key == keys.begin() ? 1 : 2; // 2 has openssl issue a fresh ticket under the newest key
+}
+
+int TicketKeys::callback(SSL* ssl, unsigned char* key_name, unsigned char* iv, EVP_CIPHER_CTX* cipher, EVP_MAC_CTX* mac, int enc) {
+    if(enc) {
+        return INSTANCE.seal(key_name, iv, cipher, mac);
+    }
+    return INSTANCE.open(key_name, iv, cipher, mac);
+}
@@ -0,0 +1,118 @@
+#ifndef TLS_H
+#define TLS_H
+
+#include <asio.hpp>
+#include <asio/awaitable.hpp>
+#include <asio/ssl.hpp>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <span>
+#include <tuple>
+#include <sys/types.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+
+namespace cfg {
+    struct SSLConfig;
+};
+
+namespace tls {
+
+    constexpr std::size_t MIN_RECORD_SIZE = 512; // the smallest fragment openssl accepts
+    constexpr std::size_t MAX_RECORD_SIZE = 16384;
+
+    /* Protocol versions, ciphers, curves, the session cache and tickets, set once before the io threads start */
+    void configure(asio::ssl::context& context, const cfg::SSLConfig* setting);
+
+    /*
+     * Dynamic record sizing for one connection. Records start small enough to fit a single tcp segment, so the client
+     * can decrypt the first bytes without waiting on a full 16KB record. Once enough bytes have gone out the records
+     * grow to the maximum, cutting the per record overhead for bulk transfers. An idle connection starts small again,
+     * the congestion window has likely collapsed.
+     */
+    class RecordSizer
+    {
+        public:
+        void prepare(SSL* ssl, std::size_t bytes);
+        void reset() {sent = 0; current = 0;}
+
+        private:
+        std::size_t sent{0}; // since the connection was last idle
+        std::size_t current{0}; // the fragment size set on the connection, 0 for openssl's default
+        std::chrono::steady_clock::time_point last_write;
+    };
+
+    /*
+     * A tls connection run by openssl directly on the socket. asio's ssl stream feeds openssl through memory bios,
+     * which keeps it from installing the session keys into the kernel. Each call is retried once the socket is ready
+     * whenever openssl would block. When kernel tls is available the kernel encrypts outgoing records and files can
+     * be sent with SSL_sendfile, otherwise openssl encrypts in user space as before.
+     */
+    class KernelStream
+    {
+        public:
+        using IOResult = asio::awaitable<std::tuple<asio::error_code, std::size_t>>;
+
+        KernelStream(asio::io_context& io_context, asio::ssl::context& context);
+        ~KernelStream();
+        KernelStream(const KernelStream&) = delete;
+        KernelStream& operator=(const KernelStream&) = delete;
+
+        asio::awaitable<asio::error_code> co_handshake();
+        asio::awaitable<asio::error_code> co_wait_readable();
+        IOResult co_read(char* buffer, std::size_t size);
+        IOResult co_write(const char* buffer, std::size_t size);
+        IOResult co_write(std::span<const asio::const_buffer> buffers); // one record or more per buffer
+        IOResult co_sendfile(int fd, off_t offset, std::size_t size); // may send less than size
+        bool kernelSend() const; // false until the handshake installs the keys, or if the kernel can't take them
+
+        asio::ip::tcp::socket& next_layer() {return socket;}
+        SSL* native_handle() {return ssl;}
+
+        private:
+        asio::awaitable<asio::error_code> wait(int ret); // waits if openssl would block, otherwise maps the failure
+
+        private:
+        asio::ip::tcp::socket socket;
+        SSL* ssl;
+    };
+
+    /*
+     * Session ticket keys, rotated every ticket_rotation. New tickets are sealed with the newest key, older keys
+     * still open tickets until they outlive the session timeout, and a ticket opened with an older key is renewed.
+     */
+    class TicketKeys
+    {
+        public:
+        static TicketKeys* getInstance();
+        void configure(std::chrono::milliseconds rotation, std::chrono::milliseconds lifetime);
+        static int callback(SSL* ssl, unsigned char* key_name, unsigned char* iv, EVP_CIPHER_CTX* cipher, EVP_MAC_CTX* mac, int enc);
+
+        private:
+        struct Key {
+            unsigned char name[16];
+            unsigned char aes_key[32];
+            unsigned char hmac_key[32];
+            std::chrono::steady_clock::time_point created;
+        };
+
+        static TicketKeys INSTANCE;
+        std::mutex mutex;
+        std::deque<Key> keys; // newest first
+        std::chrono::milliseconds rotation{0};
+        std::chrono::milliseconds lifetime{0};
+
+        private:
+        TicketKeys() {}
+        TicketKeys(const TicketKeys&) = delete;
+        TicketKeys& operator=(const TicketKeys&) = delete;
+
+        void rotate(std::chrono::steady_clock::time_point now); // mutex held
+        int seal(unsigned char* key_name, unsigned char* iv, EVP_CIPHER_CTX* cipher, EVP_MAC_CTX* mac);
+        int open(const unsigned char* key_name, unsigned char* iv, EVP_CIPHER_CTX* cipher, EVP_MAC_CTX* mac);
+    };
+};
+
+#endif
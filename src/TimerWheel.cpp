@@ -0,0 +1,151 @@
+#include "TimerWheel.h"
+#include "Socket.h"
+
+#include <sys/socket.h>
+
+using namespace timer;
+
+Wheel Wheel::INSTANCE;
+
+Wheel* Wheel::getInstance() {
+    return &Wheel::INSTANCE;
+}
+
+const char* timer::phase_to_str(phase p) {
+    switch(p) {
+    case phase::Handshake: return "handshake";
+    case phase::Idle: return "idle";
+    case phase::Read: return "read";
+    case phase::Write: return "write";
+    default: return "request";
+    }
+}
+
+/* rounded up and one past the current tick, a deadline never fires early */
+static std::uint64_t ticks_from_ms(std::uint64_t now, std::uint64_t ms) {
+    return now + (ms + TICK_MS - 1) / TICK_MS + 1;
+}
+
+Deadline::Deadline(Socket* sock, const cfg::TimeoutConfig* setting)
+: sock(sock), setting(setting), fd(sock->getRawSocket().native_handle()) {
+    if(setting->request_ms > 0) {
+        request_tick = ticks_from_ms(Wheel::getInstance()->now(), setting->request_ms);
+    }
+    sock->setDeadline(this);
+    disarm();
+}
+
+Deadline::~Deadline() {
+    auto wheel = Wheel::getInstance();
+    {
+        std::lock_guard<std::mutex> lock(wheel->mutex);
+        wheel->unlink(this);
+    }
+    sock->setDeadline(nullptr);
+}
+
+void Deadline::arm(phase next, std::size_t bytes) {
+    int timeout_ms = 0;
+    switch(next) {
+    case phase::Handshake: timeout_ms = setting->handshake_ms; break;
+    case phase::Idle: timeout_ms = setting->idle_ms; break;
+    case phase::Read: timeout_ms = setting->read_ms; break;
+    case phase::Write: timeout_ms = setting->write_ms; break;
+    default: break;
+    }
+
+    auto wheel = Wheel::getInstance();
+    if(next == phase::Write) {
+        request_tick = 0; // the response has started, from here each write's allowance bounds a long download instead
+    }
+    std::uint64_t expires = request_tick;
+    if(timeout_ms > 0) {
+        std::uint64_t allowance = timeout_ms;
+        if(next == phase::Write && setting->min_rate > 0) {
+            allowance += bytes * 1000 / setting->min_rate; // a client reading slower than min_rate runs out of time
+        }
+        std::uint64_t phase_tick = ticks_from_ms(wheel->now(), allowance);
+        expires = expires ? std::min(expires, phase_tick) : phase_tick;
+    }
+
+    std::lock_guard<std::mutex> lock(wheel->mutex);
+    if(expired()) {
+        return; // the socket is already shut down
+    }
+    current = next;
+    wheel->unlink(this);
+    if(expires) {
+        expires_tick = expires;
+        wheel->link(this);
+    }
+}
+
+/* mutex held */
+void Wheel::link(Deadline* deadline) {
+    Deadline*& head = slots[deadline->expires_tick % WHEEL_SLOTS];
+    deadline->prev = nullptr;
+    deadline->next = head;
+    if(head) {
+        head->prev = deadline;
+    }
+    head = deadline;
+    deadline->linked = true;
+}
+
+/* mutex held */
+void Wheel::unlink(Deadline* deadline) {
+    if(!deadline->linked) {
+        return;
+    }
+    if(deadline->prev) {
+        deadline->prev->next = deadline->next;
+    } else {
+        slots[deadline->expires_tick % WHEEL_SLOTS] = deadline->next;
+    }
+    if(deadline->next) {
+        deadline->next->prev = deadline->prev;
+    }
+    deadline->prev = deadline->next = nullptr;
+    deadline->linked = false;
+}
+
+/* mutex held, entries hashed to this slot for a later lap stay put */
+void Wheel::expire(std::uint64_t tick) {
+    Deadline* deadline = slots[tick % WHEEL_SLOTS];
+    while(deadline) {
+        Deadline* next = deadline->next;
+        if(deadline->expires_tick <= tick) {
+            unlink(deadline);
+            deadline->timed_out.store(true, std::memory_order_release);
+            ::shutdown(deadline->fd, SHUT_RDWR);
+            DEBUG("Timer Wheel", "client=%s timed out in %s phase", deadline->sock->getIP().c_str(), phase_to_str(deadline->current));
+        }
+        deadline = next;
+    }
+}
+
+void Wheel::start(asio::io_context& io_context) {
+    asio::co_spawn(io_context, tick(), asio::detached);
+}
+
+asio::awaitable<void> Wheel::tick() {
+    auto interval = std::chrono::milliseconds(TICK_MS);
+    asio::steady_timer timer(co_await asio::this_coro::executor);
+    auto started = std::chrono::steady_clock::now();
+    std::uint64_t processed = 0;
+    while(true) {
+        timer.expires_at(started + interval * (processed + 1));
+        auto [ec] = co_await timer.async_wait(asio::as_tuple(asio::use_awaitable));
+        if(ec) {
+            co_return;
+        }
+
+        // catch up on every tick missed while the io threads were stalled
+        auto target = static_cast<std::uint64_t>((std::chrono::steady_clock::now() - started) / interval);
+        std::lock_guard<std::mutex> lock(mutex);
+        while(processed < target) {
+            current_tick.store(++processed, std::memory_order_relaxed);
+            expire(processed);
+        }
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <asio.hpp>
+#include <asio/awaitable.hpp>
+#include <asio/steady_timer.hpp>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+#include "config.h"
+
+class Socket;
+
+namespace timer {
+
+    constexpr int TICK_MS = 250;
+    constexpr std::size_t WHEEL_SLOTS = 512; // one lap is 128s, longer deadlines sit out extra laps
+
+    enum class phase {
+        None, Handshake, Idle, Read, Write
+    };
+
+    const char* phase_to_str(phase p);
+
+    /*
+     * A connection's deadline, the earlier of the current phase's timeout and the whole request's. On expiry the
+     * socket's fd is shut down, failing any pending read or write with eof or a broken pipe. ::shutdown is safe from
+     * the wheel's thread, cancelling through asio is not. Must be destroyed before the socket is closed.
+     */
+    class Deadline
+    {
+        public:
+        Deadline(Socket* sock, const cfg::TimeoutConfig* setting);
+        ~Deadline();
+        Deadline(const Deadline&) = delete;
+        Deadline& operator=(const Deadline&) = delete;
+
+        void arm(phase next, std::size_t bytes = 0); // bytes extends a write's allowance at the minimum rate
+        void disarm() {arm(phase::None);}
+        bool expired() const {return timed_out.load(std::memory_order_acquire);}
+
+        private:
+        friend class Wheel;
+        Socket* sock;
+        const cfg::TimeoutConfig* setting;
+        int fd;
+        phase current{phase::None};
+        std::uint64_t request_tick{0}; // 0 if there's no total deadline, or once the response has started, only touched by arm
+        std::atomic<bool> timed_out{false};
+
+        // wheel state, guarded by the wheel's mutex
+        Deadline* prev{nullptr};
+        Deadline* next{nullptr};
+        bool linked{false};
+        std::uint64_t expires_tick{0};
+    };
+
+    /* Hashed timer wheel, arming and removing a deadline is O(1) no matter how many connections are open */
+    class Wheel
+    {
+        public:
+        static Wheel* getInstance();
+        void start(asio::io_context& io_context);
+        std::uint64_t now() const {return current_tick.load(std::memory_order_relaxed);}
+
+        private:
+        friend class Deadline;
+        static Wheel INSTANCE;
+        std::mutex mutex;
+        std::array<Deadline*, WHEEL_SLOTS> slots{};
+        std::atomic<std::uint64_t> current_tick{0};
+
+        private:
+        Wheel() {}
+        Wheel(const Wheel&) = delete;
+        Wheel& operator=(const Wheel&) = delete;
+
+        void link(Deadline* deadline);
+        void unlink(Deadline* deadline);
+        void expire(std::uint64_t tick);
+        asio::awaitable<void> tick();
+    };
+};
+
+#endif
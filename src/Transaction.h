@@ -3,29 +3,48 @@
 
 #include "http.h"
 #include "logger.h"
+#include "BufferPool.h"
 #include <vector>
+#include <memory_resource>
 
 class Session;
 class Socket;
 
+namespace mw {
+    struct Permit;
+}
+
+constexpr std::size_t TRANSACTION_ARENA_SIZE = 16 * 1024; // one pooled block, enough for a typical request's headers
+
+/*
+ * The request and response allocate from a monotonic arena over a pooled block, nothing is freed
+ * until the transaction ends, then the block goes back to the pool in one step.
+ */
 struct Transaction {
+    pool::Lease arena_block; // declared first, the arena must outlive everything allocated from it
+    std::pmr::monotonic_buffer_resource arena;
     Socket* sock;
-    std::vector<char> buffer;
+    pool::Lease buffer; // the raw request, trimmed to the bytes read
     std::function<asio::awaitable<void>()> finish;
     http::Request request;
     http::Response response;
     logger::SessionEntry log_entry;
+    std::vector<std::shared_ptr<mw::Permit>> permits; // concurrency slots, released once the response is sent
 
-    Transaction(Socket* sock): sock(sock), buffer(BUFSIZ), finish(nullptr) {}
+    Transaction(Socket* sock): arena_block(pool::acquire(TRANSACTION_ARENA_SIZE)), 
+    arena(arena_block.data(), arena_block.size(), std::pmr::new_delete_resource()), 
+    sock(sock), buffer(pool::acquire(BUFSIZ)), finish(nullptr), request(&arena), response(&arena) {}
     void addBytes(long additional_bytes) {log_entry.bytes += additional_bytes;}
-    void setBuffer(std::vector<char>&& new_buffer) {buffer = std::move(new_buffer);}
+    void setBuffer(pool::Lease&& new_buffer) {buffer = std::move(new_buffer);}
     void setRequest(http::Request&& new_request) {request = std::move(new_request);}
 
-    std::vector<char>* getBuffer() {return &buffer;}
+    pool::Lease* getBuffer() {return &buffer;}
     http::Response* getResponse() {return &response;}
     logger::SessionEntry* getLogEntry() {return &log_entry;}
     Socket* getSocket() {return sock;}
+    std::pmr::polymorphic_allocator<> getAllocator() {return &arena;}
     http::Request* getRequest() {return &request;}
+    void releasePermits() {permits.clear();}
 };
 
 #endif
@@ -23,6 +23,9 @@ const Config* Config::getInstance(const std::string& config_path) {
 }
 
 static void print_endpoint(const http::EndpointMethod& method, const std::string& endpoint_url) {
+    if(!logger::Logger::isEnabled(logger::level::Trace)) {
+        return;
+    }
     std::string msg = std::format(
         "route [{} {}]\n\taccess_role={}\n\tauth_role={}\n\tprotected={}\n\tauthenticator={}\n\tscript={}\n\targs={}\n",
         http::method_enum_to_str(method.m),
@@ -37,6 +40,13 @@ static void print_endpoint(const http::EndpointMethod& method, const std::string
     TRACE("Server", "%s", msg.c_str());
 }
 
+static std::string trim(const std::string& s) {
+    auto l = s.find_first_not_of(" \t\r\n");
+    if (l == std::string::npos) return "";
+    auto r = s.find_last_not_of(" \t\r\n");
+    return s.substr(l, r - l + 1);
+}
+
 static int get_seconds_multiplier(const std::string& unit) {
     if (unit == "d" || unit == "day" || unit == "days") {
         return 24*3600;
@@ -91,6 +101,74 @@ static int get_seconds_from_time_str(const char* data) {
     return get_seconds_multiplier(unit)*value;
 }
 
+/* accepts a byte count with an optional KB, MB or GB suffix */
+static std::size_t get_bytes_from_size_str(const char* data, std::size_t fallback) {
+    if(!data) {
+        return fallback;
+    }
+
+    std::string token = trim(data);
+    std::size_t pos = 0;
+    while (pos < token.size() && std::isdigit(static_cast<unsigned char>(token[pos]))) {
+        ++pos;
+    }
+    if (pos == 0) {
+        WARN("Server", "invalid size value '%s', defaulting to %zu bytes", token.c_str(), fallback);
+        return fallback;
+    }
+    std::size_t value = 0;
+    try {
+        value = std::stoull(token.substr(0, pos));
+    }
+    catch (const std::exception&) {
+        WARN("Server", "couldn't parse numeric part of '%s', defaulting to %zu bytes", token.c_str(), fallback);
+        return fallback;
+    }
+    std::string unit = trim(token.substr(pos));
+    std::transform(unit.begin(), unit.end(), unit.begin(), [](unsigned char c){ return static_cast<char>(std::toupper(c)); });
+    if(unit.empty() || unit == "B") {
+        return value;
+    } else if (unit == "KB" || unit == "K") {
+        return value << 10;
+    } else if (unit == "MB" || unit == "M") {
+        return value << 20;
+    } else if (unit == "GB" || unit == "G") {
+        return value << 30;
+    }
+    WARN("Server", "unknown size unit '%s', defaulting to %zu bytes", unit.c_str(), fallback);
+    return fallback;
+}
+
+static int get_milliseconds_from_time_str(const char* data, int fallback) {
+    if(!data) {
+        return fallback;
+    }
+
+    std::string token = trim(data);
+    std::size_t pos = 0;
+    while (pos < token.size() && std::isdigit(static_cast<unsigned char>(token[pos]))) {
+        ++pos;
+    }
+    if (pos == 0) {
+        WARN("Server", "invalid time value '%s', defaulting to %d ms", token.c_str(), fallback);
+        return fallback;
+    }
+    int value = 0;
+    try {
+        value = std::stoi(token.substr(0, pos));
+    }
+    catch (const std::exception&) {
+        WARN("Server", "couldn't parse numeric part of '%s', defaulting to %d ms", token.c_str(), fallback);
+        return fallback;
+    }
+    std::string unit = token.substr(pos);
+    std::transform(unit.begin(), unit.end(), unit.begin(), [](unsigned char c){ return std::tolower(c); });
+    if(unit == "ms") {
+        return value;
+    }
+    return get_seconds_multiplier(unit.empty() ? "s" : unit)*value*1000;
+}
+
 static int load_int(const char* int_str, int fallback, const std::string& fallback_log) {
     if(!int_str) {
         DEBUG("Server", "%s", fallback_log.c_str());
@@ -133,13 +211,6 @@ static int load_refill_rate(const char* buf) {
     return value / get_seconds_multiplier(rate_str.substr(pos + 1));
 }
 
-static std::string trim(const std::string& s) {
-    auto l = s.find_first_not_of(" \t\r\n");
-    if (l == std::string::npos) return "";
-    auto r = s.find_last_not_of(" \t\r\n");
-    return s.substr(l, r - l + 1);
-}
-
 static std::string parseXff(const std::string& xff) {
     std::istringstream in(xff);
     std::string part;
@@ -271,6 +342,60 @@ static std::unique_ptr<mw::Middleware> load_limiter(tinyxml2::XMLElement* algo_e
     }
 }
 
+static double load_ratio(const char* ratio_str, double fallback) {
+    if(!ratio_str) {
+        return fallback;
+    }
+    try {
+        double ratio = std::stod(ratio_str);
+        if(ratio > 0.0 && ratio < 1.0) {
+            return ratio;
+        }
+    } catch (const std::exception&) {}
+    WARN("Server", "invalid ratio '%s' for concurrency limit, must be in (0, 1), defaulting to %.2f", ratio_str, fallback);
+    return fallback;
+}
+
+static std::unique_ptr<mw::Middleware> load_concurrency_limiter(tinyxml2::XMLElement* limit_elem) {
+    cfg::ConcurrencySetting setting;
+    setting.max_in_flight = load_int(limit_elem->Attribute("max_in_flight"), cfg::DEFAULT_MAX_IN_FLIGHT, 
+        std::format("failed to parse max_in_flight for concurrency limit, defaulting to {}", cfg::DEFAULT_MAX_IN_FLIGHT));
+    setting.queue_size = load_int(limit_elem->Attribute("queue"), cfg::DEFAULT_QUEUE_SIZE, 
+        std::format("failed to parse queue for concurrency limit, defaulting to {} waiters", cfg::DEFAULT_QUEUE_SIZE));
+    setting.queue_timeout_ms = get_milliseconds_from_time_str(limit_elem->Attribute("queue_timeout"), cfg::DEFAULT_QUEUE_TIMEOUT_MS);
+
+    std::string algo = limit_elem->Attribute("algorithm") ? limit_elem->Attribute("algorithm") : "static";
+    std::transform(algo.begin(), algo.end(), algo.begin(), [](unsigned char c){ return static_cast<char>(std::tolower(c)); });
+    if(algo == "aimd" || algo == "adaptive") {
+        setting.algorithm = cfg::ConcurrencySetting::Algorithm::AIMD;
+        setting.min_limit = std::max(1, load_int(limit_elem->Attribute("min_limit"), 1, "failed to parse min_limit for concurrency limit, defaulting to 1"));
+        setting.max_limit = std::max(setting.min_limit, load_int(limit_elem->Attribute("max_limit"), setting.max_in_flight, 
+            std::format("failed to parse max_limit for concurrency limit, defaulting to {}", setting.max_in_flight)));
+        setting.target_latency_ms = get_milliseconds_from_time_str(limit_elem->Attribute("target_latency"), cfg::DEFAULT_TARGET_LATENCY_MS);
+        setting.backoff = load_ratio(limit_elem->Attribute("backoff"), cfg::DEFAULT_BACKOFF_RATIO);
+        setting.max_in_flight = std::clamp(setting.max_in_flight, setting.min_limit, setting.max_limit);
+    } else if (algo != "static") {
+        WARN("Server", "concurrency algorithm=%s not supported, defaulting to algorithm='static'", algo.c_str());
+    }
+    setting.max_in_flight = std::max(1, setting.max_in_flight);
+    setting.queue_size = std::max(0, setting.queue_size);
+
+    DEBUG("Server", "Concurrency [algorithm='%s' limit=%d queue=%d queue_timeout=%dms] loaded", 
+        setting.algorithm == cfg::ConcurrencySetting::Algorithm::AIMD ? "aimd" : "static", setting.max_in_flight, setting.queue_size, setting.queue_timeout_ms);
+    return std::make_unique<mw::ConcurrencyLimiter>(setting);
+}
+
+std::unique_ptr<mw::Middleware> Config::loadGlobalConcurrencyLimit(tinyxml2::XMLDocument* doc) {
+    auto global_elem = doc->FirstChildElement("ServerConfig")->FirstChildElement("Global");
+    tinyxml2::XMLElement* limit_elem;
+    if(!global_elem || !(limit_elem = global_elem->FirstChildElement("Concurrency"))) {
+        DEBUG("Server", "no global concurrency limit configured");
+        return nullptr;
+    }
+    TRACE("Server", "loading global concurrency limiter ...");
+    return load_concurrency_limiter(limit_elem);
+}
+
 std::unique_ptr<mw::Middleware> Config::loadGlobalRateLimit(tinyxml2::XMLDocument* doc, bool* uses_ip = nullptr) {
     auto global_elem = doc->FirstChildElement("ServerConfig")->FirstChildElement("Global");
     if(!global_elem) {
@@ -291,6 +416,55 @@ std::unique_ptr<mw::Middleware> Config::loadGlobalRateLimit(tinyxml2::XMLDocumen
     }
 }
 
+void Config::loadLoadShedding(tinyxml2::XMLDocument* doc) {
+    auto global_elem = doc->FirstChildElement("ServerConfig")->FirstChildElement("Global");
+    tinyxml2::XMLElement* shed_elem;
+    if(!global_elem || !(shed_elem = global_elem->FirstChildElement("LoadShedding"))) {
+        DEBUG("Server", "no load shedding configured");
+        return;
+    }
+    if(shed_elem->Attribute("disable") && !std::strcmp(shed_elem->Attribute("disable"), "true")) {
+        DEBUG("Server", "load shedding disabled");
+        return;
+    }
+
+    load_shedding.active = true;
+    load_shedding.sample_interval_ms = std::max(1, get_milliseconds_from_time_str(shed_elem->Attribute("interval"), cfg::DEFAULT_LAG_SAMPLE_MS));
+    load_shedding.shed_scripts_lag_ms = get_milliseconds_from_time_str(shed_elem->Attribute("shed_scripts"), cfg::DEFAULT_SHED_SCRIPTS_LAG_MS);
+    load_shedding.stop_accept_lag_ms = get_milliseconds_from_time_str(shed_elem->Attribute("stop_accept"), cfg::DEFAULT_STOP_ACCEPT_LAG_MS);
+    if(load_shedding.stop_accept_lag_ms < load_shedding.shed_scripts_lag_ms) {
+        WARN("Server", "load shedding stop_accept=%dms is below shed_scripts=%dms, scripts will never be shed before accepting stops", 
+            load_shedding.stop_accept_lag_ms, load_shedding.shed_scripts_lag_ms);
+    }
+    DEBUG("Server", "LoadShedding [interval=%dms shed_scripts=%dms stop_accept=%dms] loaded", 
+        load_shedding.sample_interval_ms, load_shedding.shed_scripts_lag_ms, load_shedding.stop_accept_lag_ms);
+}
+
+void Config::loadBuffers(tinyxml2::XMLDocument* doc) {
+    auto global_elem = doc->FirstChildElement("ServerConfig")->FirstChildElement("Global");
+    tinyxml2::XMLElement* buffers_elem;
+    if(!global_elem || !(buffers_elem = global_elem->FirstChildElement("Buffers"))) {
+        return;
+    }
+    buffers.huge_pages = buffers_elem->Attribute("huge_pages") && !std::strcmp(buffers_elem->Attribute("huge_pages"), "true");
+    DEBUG("Server", "Buffers [huge_pages=%s] loaded", buffers.huge_pages ? "true" : "false");
+}
+
+void Config::loadTimeouts(tinyxml2::XMLDocument* doc) {
+    auto global_elem = doc->FirstChildElement("ServerConfig")->FirstChildElement("Global");
+    tinyxml2::XMLElement* timeouts_elem;
+    if(global_elem && (timeouts_elem = global_elem->FirstChildElement("Timeouts"))) {
+        timeouts.handshake_ms = get_milliseconds_from_time_str(timeouts_elem->Attribute("handshake"), cfg::DEFAULT_HANDSHAKE_TIMEOUT_MS);
+        timeouts.idle_ms = get_milliseconds_from_time_str(timeouts_elem->Attribute("idle"), cfg::DEFAULT_IDLE_TIMEOUT_MS);
+        timeouts.read_ms = get_milliseconds_from_time_str(timeouts_elem->Attribute("read"), cfg::DEFAULT_READ_TIMEOUT_MS);
+        timeouts.write_ms = get_milliseconds_from_time_str(timeouts_elem->Attribute("write"), cfg::DEFAULT_WRITE_TIMEOUT_MS);
+        timeouts.request_ms = get_milliseconds_from_time_str(timeouts_elem->Attribute("request"), cfg::DEFAULT_REQUEST_TIMEOUT_MS);
+        timeouts.min_rate = get_bytes_from_size_str(timeouts_elem->Attribute("min_rate"), cfg::DEFAULT_MIN_SEND_RATE);
+    }
+    DEBUG("Server", "Timeouts [handshake=%dms idle=%dms read=%dms write=%dms request=%dms min_rate=%zuB/s] loaded", timeouts.handshake_ms, 
+        timeouts.idle_ms, timeouts.read_ms, timeouts.write_ms, timeouts.request_ms, timeouts.min_rate);
+}
+
 void Config::loadPipeline(tinyxml2::XMLDocument* doc) {
     bool global_uses_ip = true;
     auto limiter = loadGlobalRateLimit(doc, &global_uses_ip);
@@ -300,11 +474,18 @@ void Config::loadPipeline(tinyxml2::XMLDocument* doc) {
         PIPELINE.components.push_back(std::move(limiter));
     }
     PIPELINE.components.push_back(std::make_unique<mw::Parser>());
+    if(load_shedding.active) {
+        PIPELINE.components.push_back(std::make_unique<mw::LoadShedder>());
+    }
     if(limiter && !global_uses_ip) {
         TRACE("Server", "global rate limiting requires parsing");
         PIPELINE.components.push_back(std::move(limiter));
     }
     PIPELINE.components.push_back(std::make_unique<mw::RateLimiter>());
+    PIPELINE.components.push_back(std::make_unique<mw::Bulkhead>()); // route slots first, a queued request shouldn't hold a global slot
+    if(auto concurrency_limiter = loadGlobalConcurrencyLimit(doc)) {
+        PIPELINE.components.push_back(std::move(concurrency_limiter));
+    }
     PIPELINE.components.push_back(std::make_unique<mw::Authenticator>());
     TRACE("Server", "pipeline loaded");
 }
@@ -351,6 +532,10 @@ void Config::loadRoutes(tinyxml2::XMLDocument* doc, const std::string& content_p
         else {
             method.access_role = VIEWER_ROLE_HASH;
         }
+        if((method.access_role_id = findRoleID(method.access_role)) == NO_ROLE_ID) {
+            WARN("Server", "route [%s %s] requires undefined access role=%s, no client will be authorized", 
+                method_str.c_str(), endpoint_url.c_str(), method.access_role.c_str());
+        }
 
         method.is_authenticator = route_el->Attribute("authenticator") && std::string(route_el->Attribute("authenticator")) == "true";
         if(method.is_authenticator) {
@@ -361,12 +546,44 @@ void Config::loadRoutes(tinyxml2::XMLDocument* doc, const std::string& content_p
             }
         }
         method.args = route_el->Attribute("args") ? http::arg_str_to_enum(route_el->Attribute("args")) : http::arg_type::None;
+        if(const char* admin = route_el->Attribute("admin")) {
+            std::string action = admin;
+            if(action != "revoke" && action != "log_level") {
+                FATAL("Server", "route [%s %s] has unknown admin action=%s", method_str.c_str(), endpoint_url.c_str(), admin);
+            }
+            if(!method.is_protected || method.m != http::method::Post) {
+                FATAL("Server", "admin route [%s %s] must be a protected POST route", method_str.c_str(), endpoint_url.c_str());
+            }
+            if(action == "revoke") {
+                method.handler = [](Transaction* txn) -> asio::awaitable<void> {
+                    RevokeHandler handler(txn);
+                    co_await handler.handle();
+                };
+            } else {
+                method.handler = [](Transaction* txn) -> asio::awaitable<void> {
+                    LogLevelHandler handler(txn);
+                    co_await handler.handle();
+                };
+            }
+        }
+        if(const char* sample = route_el->Attribute("log_sample")) {
+            try {
+                method.log_sample = static_cast<std::uint32_t>(std::max(1, std::stoi(sample)));
+            } catch (const std::exception&) {
+                WARN("Server", "route [%s %s] has invalid log_sample=%s, logging every request", method_str.c_str(), endpoint_url.c_str(), sample);
+            }
+        }
         if (method.m != http::method::Not_Allowed && !endpoint_url.empty()) {
                 tinyxml2::XMLElement* rate_limit_el = route_el->FirstChildElement("RateLimit");
                 if(rate_limit_el) {
                     TRACE("Server", "loading rate limiter for [%s %s] ...", method_str.c_str(), endpoint_url.c_str());
                     method.rate_limiter = std::shared_ptr<mw::Middleware>(load_limiter(rate_limit_el));
                 }
+                tinyxml2::XMLElement* concurrency_el = route_el->FirstChildElement("Concurrency");
+                if(concurrency_el) {
+                    TRACE("Server", "loading concurrency limiter for [%s %s] ...", method_str.c_str(), endpoint_url.c_str());
+                    method.concurrency_limiter = std::shared_ptr<mw::Middleware>(load_concurrency_limiter(concurrency_el));
+                }
                 print_endpoint(method, endpoint_url);
                 router->updateEndpoint(endpoint_url, std::move(method));
             } 
@@ -385,6 +602,11 @@ const Role* Config::findRole(const std::string& role) const {
     return &it->second;
 }
 
+RoleID Config::findRoleID(const std::string& role_title) const {
+    const Role* role = findRole(role_title);
+    return role ? role->id : NO_ROLE_ID;
+}
+
 void display_role(cfg::Role* role) {
     std::string includes;
     for (const auto& include : role->includes) {
@@ -394,10 +616,67 @@ void display_role(cfg::Role* role) {
         includes.pop_back(); 
         includes.pop_back(); 
     }
-    std::string final_msg = std::format("role [{}]\n\t{}\n", role->title, includes);
+    std::string final_msg = std::format("role [{} id={} grants={}]\n\t{}\n", role->title, role->id, role->grants.count(), includes);
     TRACE("Server", "%s", final_msg.c_str());
 }
 
+/* assigns dense ids, then expands includes until every role's grants are transitively closed */
+void Config::compileRoles() {
+    std::vector<Role*> table(MAX_ROLES, nullptr);
+    std::vector<std::string> titles;
+    for (auto& [title, role] : roles) {
+        if(role.id < NO_ROLE_ID) {
+            table[role.id] = &role; // builtin roles have fixed ids
+        } else {
+            titles.push_back(title);
+        }
+    }
+    std::sort(titles.begin(), titles.end()); // stable ids across restarts
+
+    RoleID next_id = ADMIN_ROLE_ID + 1;
+    for (const auto& title : titles) {
+        if(next_id >= NO_ROLE_ID) {
+            FATAL("Server", "loading configuration: too many roles, at most %zu are supported", MAX_ROLES - 1);
+        }
+        Role& role = roles[title];
+        role.id = next_id++;
+        table[role.id] = &role;
+    }
+
+    for (auto& [title, role] : roles) {
+        role.grants.reset();
+        role.grants.set(role.id);
+        for (const auto& include : role.includes) {
+            auto it = roles.find(include);
+            if(it == roles.end()) {
+                WARN("Server", "role=%s includes undefined role=%s, ignoring", title.c_str(), include.c_str());
+                continue;
+            }
+            role.grants.set(it->second.id);
+        }
+    }
+
+    bool changed = true;
+    while(changed) { // fixpoint, terminates since grants only grow, handles cycles
+        changed = false;
+        for (Role* role : table) {
+            if(!role) {
+                continue;
+            }
+            RoleSet closed = role->grants;
+            for (std::size_t id = 0; id < MAX_ROLES; ++id) {
+                if(role->grants.test(id) && table[id]) {
+                    closed |= table[id]->grants;
+                }
+            }
+            if(closed != role->grants) {
+                role->grants = closed;
+                changed = true;
+            }
+        }
+    }
+}
+
 void Config::loadRoles(tinyxml2::XMLDocument* doc) {
     roles[ADMIN_ROLE_HASH] = ADMIN;
     roles[USER_ROLE_HASH] = USER;
@@ -405,6 +684,7 @@ void Config::loadRoles(tinyxml2::XMLDocument* doc) {
 
     tinyxml2::XMLElement* role_config = doc->FirstChildElement("ServerConfig")->FirstChildElement("Roles");
     if (!role_config) {
+        compileRoles();
         return; 
     }
 
@@ -433,6 +713,9 @@ void Config::loadRoles(tinyxml2::XMLDocument* doc) {
             include_el = include_el->NextSiblingElement("Includes");
         }
 
+        if(auto existing = roles.find(role.title); existing != roles.end()) {
+            role.id = existing->second.id; // redefined builtins keep their reserved id
+        }
         roles[role.title] = role;
        
         if (add_to_full_include_roles) {
@@ -446,11 +729,73 @@ void Config::loadRoles(tinyxml2::XMLDocument* doc) {
             role->includes.push_back(title);
         }
     }
+    compileRoles();
     for (auto [title, role]: roles) {
         display_role(&role);
     }
 }
 
+void Config::loadLogging(tinyxml2::XMLDocument* doc) {
+    tinyxml2::XMLElement* logging_elem = doc->FirstChildElement("ServerConfig")->FirstChildElement("Logging");
+    if(!logging_elem) {
+        return;
+    }
+
+    if(const char* policy_attr = logging_elem->Attribute("full_policy")) {
+        std::string policy = trim(policy_attr);
+        std::transform(policy.begin(), policy.end(), policy.begin(), [](unsigned char c){ return static_cast<char>(std::tolower(c)); });
+        if(policy != "drop_newest" && policy != "drop_oldest" && policy != "block") {
+            WARN("Server", "log queue full_policy=%s not supported, defaulting to full_policy='drop_newest'", policy.c_str());
+        }
+        logger::Logger::getInstance()->setFullPolicy(logger::full_policy_str_to_enum(policy));
+        DEBUG("Server", "Logging [full_policy=%s] loaded", policy.c_str());
+    }
+
+    if(const char* level_attr = logging_elem->Attribute("level")) {
+        std::string level = trim(level_attr);
+        std::transform(level.begin(), level.end(), level.begin(), [](unsigned char c){ return static_cast<char>(std::tolower(c)); });
+        logger::level threshold = logger::level_str_to_enum(level, logger::level::Trace);
+        if(threshold == logger::level::Trace && level != "trace") {
+            WARN("Server", "log level=%s not supported, defaulting to level='trace'", level.c_str());
+        }
+        logger::Logger::getInstance()->setThreshold(threshold);
+        DEBUG("Server", "Logging [level=%s] loaded", logger::level_to_str(threshold).c_str());
+    }
+
+    if(const char* rotate_attr = logging_elem->Attribute("rotate")) {
+        std::string rotate = trim(rotate_attr);
+        std::transform(rotate.begin(), rotate.end(), rotate.begin(), [](unsigned char c){ return static_cast<char>(std::tolower(c)); });
+        if(rotate == "hourly") {
+            log_rotation.interval = logger::rotation::Hourly;
+        } else if (rotate == "none") {
+            log_rotation.interval = logger::rotation::None;
+        } else if (rotate != "daily") {
+            WARN("Server", "log rotate=%s not supported, defaulting to rotate='daily'", rotate.c_str());
+        }
+    }
+    log_rotation.max_bytes = get_bytes_from_size_str(logging_elem->Attribute("max_size"), 0);
+    log_rotation.compress = logging_elem->Attribute("compress") && !std::strcmp(logging_elem->Attribute("compress"), "true");
+    const char* interval = log_rotation.interval == logger::rotation::Hourly ? "hourly" : 
+                           log_rotation.interval == logger::rotation::None ? "none" : "daily";
+    DEBUG("Server", "Logging [rotate=%s max_size=%zu compress=%s] loaded", interval, log_rotation.max_bytes, log_rotation.compress ? "true" : "false");
+}
+
+void Config::loadRevocation(tinyxml2::XMLDocument* doc) {
+    tinyxml2::XMLElement* jwt_elem = doc->FirstChildElement("ServerConfig")->FirstChildElement("JWT");
+    tinyxml2::XMLElement* revocation_elem;
+    if(!jwt_elem || !(revocation_elem = jwt_elem->FirstChildElement("Revocation"))) {
+        DEBUG("Server", "no revocation file configured, revocations are kept in memory");
+        return;
+    }
+
+    revocation.file_path = revocation_elem->Attribute("file") ? revocation_elem->Attribute("file") : "";
+    revocation.reload_interval_ms = std::max(1000, get_milliseconds_from_time_str(revocation_elem->Attribute("interval"), cfg::DEFAULT_REVOCATION_INTERVAL_MS));
+    if(revocation.file_path.empty()) {
+        WARN("Server", "jwt revocation is missing file attribute, revocations are kept in memory");
+    }
+    DEBUG("Server", "Revocation [file=%s interval=%dms] loaded", revocation.file_path.c_str(), revocation.reload_interval_ms);
+}
+
 void Config::loadJWTSecretFromFile(tinyxml2::XMLElement* secret_elem) {
     std::string file_path = secret_elem->GetText() == nullptr ? "" : secret_elem->GetText(); // Let errno handle it
     int filefd = open(file_path.c_str(), O_RDONLY);
@@ -569,7 +914,7 @@ void Config::loadErrorPages(tinyxml2::XMLDocument* doc) {
             print_error_page(error_page, file);
             router->addErrorPage(std::move(error_page), std::move(file));
         }
-        error_pg = error_pg_elem->NextSiblingElement("ErrorPage");
+        error_pg = error_pg->NextSiblingElement("ErrorPage");
     }
 }
 
@@ -660,9 +1005,11 @@ void Config::initialize(const std::string& config_path) {
     else {
         this->log_path = resolve_log_path("./log");
     }
-    logger->addSink(std::move(std::make_unique<logger::FileSink>(log_path, host_name)));
+    loadLogging(&doc);
+    logger->addSink(std::move(std::make_unique<logger::FileSink>(log_path, host_name, log_rotation)));
 
     loadJWTSecret(&doc);
+    loadRevocation(&doc);
 
     tinyxml2::XMLElement* host_port = doc.FirstChildElement("ServerConfig")->FirstChildElement("Port");
     port = host_port ? std::stoi(host_port->GetText()) : 80;
@@ -673,6 +1020,9 @@ void Config::initialize(const std::string& config_path) {
     loadSSL(&doc);
     loadRoutes(&doc, content_path);
     loadHostIP();
+    loadLoadShedding(&doc);
+    loadBuffers(&doc);
+    loadTimeouts(&doc);
     loadPipeline(&doc);
 }
 
@@ -697,6 +1047,33 @@ void cfg::Config::loadSSL(tinyxml2::XMLDocument* doc) {
     }
     ssl.key_path = key->GetText();
     port = port == 80 ? 443 : port;
+
+    if(auto protocol = ssl_config->FirstChildElement("Protocol")) {
+        const char* min_version = protocol->Attribute("min_version");
+        if(min_version && (std::string(min_version) == "1.2" || std::string(min_version) == "1.3")) {
+            ssl.min_version = min_version;
+        } else if(min_version) {
+            WARN("Server", "unsupported tls min_version '%s', defaulting to %s", min_version, ssl.min_version.c_str());
+        }
+        ssl.ciphers = protocol->Attribute("ciphers") ? protocol->Attribute("ciphers") : ssl.ciphers;
+        ssl.ciphersuites = protocol->Attribute("ciphersuites") ? protocol->Attribute("ciphersuites") : ssl.ciphersuites;
+        ssl.curves = protocol->Attribute("curves") ? protocol->Attribute("curves") : ssl.curves;
+    }
+    if(auto sessions = ssl_config->FirstChildElement("Sessions")) {
+        ssl.session_cache_size = sessions->IntAttribute("cache_size", static_cast<int>(cfg::DEFAULT_SESSION_CACHE_SIZE));
+        ssl.session_timeout_ms = get_milliseconds_from_time_str(sessions->Attribute("timeout"), cfg::DEFAULT_SESSION_TIMEOUT_MS);
+        ssl.tickets = sessions->BoolAttribute("tickets", true);
+        ssl.ticket_rotation_ms = get_milliseconds_from_time_str(sessions->Attribute("ticket_rotation"), cfg::DEFAULT_TICKET_ROTATION_MS);
+    }
+    if(auto records = ssl_config->FirstChildElement("Records")) {
+        ssl.dynamic_records = records->BoolAttribute("dynamic", true);
+        ssl.small_record_size = get_bytes_from_size_str(records->Attribute("small"), cfg::DEFAULT_SMALL_RECORD_SIZE);
+        ssl.record_boost_bytes = get_bytes_from_size_str(records->Attribute("boost_after"), cfg::DEFAULT_RECORD_BOOST_BYTES);
+        ssl.record_idle_ms = get_milliseconds_from_time_str(records->Attribute("idle"), cfg::DEFAULT_RECORD_IDLE_MS);
+    }
+    if(auto offload = ssl_config->FirstChildElement("KernelTLS")) {
+        ssl.kernel_tls = offload->BoolAttribute("enabled", false);
+    }
 }
 
 void cfg::Config::loadHostIP() {
@@ -12,6 +12,12 @@
 #include <algorithm>
 #include <cctype>
 #include <stdexcept>
+#include <bitset>
+#include <cstdint>
+
+namespace cfg {
+    using RoleID = std::uint16_t; // ahead of the includes, http.h pulls in Router.h which needs it
+}
 
 #include "logger_macros.h"
 #include "http.h"
@@ -29,16 +35,51 @@ constexpr int DEFAULT_WINDOW_SECONDS = 60;
 constexpr int DEFAULT_MAX_REQUESTS = 3000;
 constexpr int DEFAULT_TOKEN_CAPACITY = 60;
 constexpr int DEFAULT_REFILL_RATE = 2; /* in tokens/s, i.e. 1 token/s */
+constexpr int DEFAULT_MAX_IN_FLIGHT = 256;
+constexpr int DEFAULT_QUEUE_SIZE = 128;
+constexpr int DEFAULT_QUEUE_TIMEOUT_MS = 2000;
+constexpr int DEFAULT_TARGET_LATENCY_MS = 250;
+constexpr double DEFAULT_BACKOFF_RATIO = 0.9;
+constexpr int DEFAULT_LAG_SAMPLE_MS = 50;
+constexpr int DEFAULT_SHED_SCRIPTS_LAG_MS = 100;
+constexpr int DEFAULT_STOP_ACCEPT_LAG_MS = 500;
+constexpr int DEFAULT_REVOCATION_INTERVAL_MS = 30000;
+constexpr int DEFAULT_HANDSHAKE_TIMEOUT_MS = 10000;
+constexpr int DEFAULT_IDLE_TIMEOUT_MS = 30000;
+constexpr int DEFAULT_READ_TIMEOUT_MS = 10000;
+constexpr int DEFAULT_WRITE_TIMEOUT_MS = 30000;
+constexpr int DEFAULT_REQUEST_TIMEOUT_MS = 300000;
+constexpr std::size_t DEFAULT_MIN_SEND_RATE = 4096; // bytes/s
+constexpr const char* DEFAULT_TLS_CIPHERS = "ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256:ECDHE-ECDSA-CHACHA20-POLY1305:"
+                                            "ECDHE-RSA-CHACHA20-POLY1305:ECDHE-ECDSA-AES256-GCM-SHA384:ECDHE-RSA-AES256-GCM-SHA384";
+constexpr const char* DEFAULT_TLS_CIPHERSUITES = "TLS_AES_128_GCM_SHA256:TLS_CHACHA20_POLY1305_SHA256:TLS_AES_256_GCM_SHA384";
+constexpr const char* DEFAULT_TLS_CURVES = "X25519:P-256:P-384";
+constexpr long DEFAULT_SESSION_CACHE_SIZE = 20480;
+constexpr int DEFAULT_SESSION_TIMEOUT_MS = 3600000;
+constexpr int DEFAULT_TICKET_ROTATION_MS = 3600000;
+constexpr std::size_t DEFAULT_SMALL_RECORD_SIZE = 1369; // one record per 1460 byte segment, after ip, tcp options and tls overhead
+constexpr std::size_t DEFAULT_RECORD_BOOST_BYTES = 65536;
+constexpr int DEFAULT_RECORD_IDLE_MS = 1000;
 
 /* Returns the sockets ip address */
 std::string DEFAULT_MAKE_KEY(Transaction* txn);
 
+constexpr std::size_t MAX_ROLES = 256;
+constexpr RoleID VIEWER_ROLE_ID = 0;
+constexpr RoleID USER_ROLE_ID = 1;
+constexpr RoleID ADMIN_ROLE_ID = 2;
+constexpr RoleID NO_ROLE_ID = MAX_ROLES - 1; // reserved, never granted to any role
+
+using RoleSet = std::bitset<MAX_ROLES>;
+
 struct Role {
     std::string title;
     std::vector<std::string> includes;
+    RoleID id{NO_ROLE_ID};
+    RoleSet grants{}; // transitive closure of includes (and itself), compiled at config load
 
-    bool includesRole(const std::string& role) const {
-        return (title == role) || (std::find(includes.begin(), includes.end(), role) != includes.end());
+    bool includesRole(RoleID role) const {
+        return grants.test(role);
     }
 };
 
@@ -56,7 +97,19 @@ struct TokenBucketSetting: public RateSetting {
 
 struct FixedWindowSetting: public RateSetting {
     int window_seconds{DEFAULT_WINDOW_SECONDS};
-    int max_requests{DEFAULT_MAX_REQUESTS};  
+    int max_requests{DEFAULT_MAX_REQUESTS};
+};
+
+struct ConcurrencySetting {
+    enum class Algorithm { Static, AIMD };
+    Algorithm algorithm{Algorithm::Static};
+    int max_in_flight{DEFAULT_MAX_IN_FLIGHT}; // initial limit for AIMD
+    int queue_size{DEFAULT_QUEUE_SIZE};
+    int queue_timeout_ms{DEFAULT_QUEUE_TIMEOUT_MS};
+    int min_limit{1};
+    int max_limit{DEFAULT_MAX_IN_FLIGHT};
+    int target_latency_ms{DEFAULT_TARGET_LATENCY_MS};
+    double backoff{DEFAULT_BACKOFF_RATIO}; // multiplicative decrease applied on congestion
 };
 
 std::string get_role_hash(std::string role_title);
@@ -64,17 +117,56 @@ std::string get_role_hash(std::string role_title);
 const std::string VIEWER_ROLE_HASH = get_role_hash("viewer");
 const std::string USER_ROLE_HASH = get_role_hash("user");
 const std::string ADMIN_ROLE_HASH = get_role_hash("admin");
-const Role VIEWER = {VIEWER_ROLE_HASH, {}};
-const Role USER = {USER_ROLE_HASH, {VIEWER_ROLE_HASH}};
-const Role ADMIN = {ADMIN_ROLE_HASH, {USER_ROLE_HASH, VIEWER_ROLE_HASH}};
+const Role VIEWER = {VIEWER_ROLE_HASH, {}, VIEWER_ROLE_ID};
+const Role USER = {USER_ROLE_HASH, {VIEWER_ROLE_HASH}, USER_ROLE_ID};
+const Role ADMIN = {ADMIN_ROLE_HASH, {USER_ROLE_HASH, VIEWER_ROLE_HASH}, ADMIN_ROLE_ID};
 
 const std::string NO_HOST_NAME  = "server";
 const size_t DEFAULT_JWT_SECRET_SIZE = 64;
 
+struct LoadSheddingConfig {
+    bool active{false};
+    int sample_interval_ms{DEFAULT_LAG_SAMPLE_MS};
+    int shed_scripts_lag_ms{DEFAULT_SHED_SCRIPTS_LAG_MS}; // reject new script requests above this lag
+    int stop_accept_lag_ms{DEFAULT_STOP_ACCEPT_LAG_MS}; // pause accepting connections above this lag
+};
+
+struct RevocationConfig {
+    std::string file_path{""}; // optional, revocations are kept in memory only without it
+    int reload_interval_ms{DEFAULT_REVOCATION_INTERVAL_MS}; // how often the file is checked for changes and expired entries pruned
+};
+
+/* 0 disables a timeout */
+struct TimeoutConfig {
+    int handshake_ms{DEFAULT_HANDSHAKE_TIMEOUT_MS};
+    int idle_ms{DEFAULT_IDLE_TIMEOUT_MS}; // from accepting until the request starts to arrive
+    int read_ms{DEFAULT_READ_TIMEOUT_MS}; // reading the request, the headers and body are read together
+    int write_ms{DEFAULT_WRITE_TIMEOUT_MS}; // base allowance for each write
+    int request_ms{DEFAULT_REQUEST_TIMEOUT_MS}; // until the response starts, scripts included, writes are bounded by write_ms and min_rate
+    std::size_t min_rate{DEFAULT_MIN_SEND_RATE}; // bytes/s, each write's allowance grows by its size at this rate
+};
+
+struct BufferConfig {
+    bool huge_pages{false}; // back the io buffer pools with 2MB pages
+};
+
 struct SSLConfig {
     bool active;
     std::string key_path;
     std::string certificate_path;
+    std::string min_version{"1.2"}; // 1.2 or 1.3, tls 1.3 is always offered
+    std::string ciphers{DEFAULT_TLS_CIPHERS}; // tls 1.2, openssl cipher list format
+    std::string ciphersuites{DEFAULT_TLS_CIPHERSUITES}; // tls 1.3
+    std::string curves{DEFAULT_TLS_CURVES}; // ecdhe groups in order of preference
+    long session_cache_size{DEFAULT_SESSION_CACHE_SIZE}; // 0 disables the server side cache
+    int session_timeout_ms{DEFAULT_SESSION_TIMEOUT_MS};
+    bool tickets{true};
+    int ticket_rotation_ms{DEFAULT_TICKET_ROTATION_MS};
+    bool dynamic_records{true};
+    std::size_t small_record_size{DEFAULT_SMALL_RECORD_SIZE};
+    std::size_t record_boost_bytes{DEFAULT_RECORD_BOOST_BYTES}; // sent in small records before switching to full size ones
+    int record_idle_ms{DEFAULT_RECORD_IDLE_MS}; // idle time after which records start small again
+    bool kernel_tls{false}; // hand the session keys to the kernel after the handshake, files are then sent with sendfile
 };
 
 using Roles = std::unordered_map<std::string, Role>;
@@ -87,11 +179,16 @@ class Config
 
     mw::Pipeline* getPipeline() const;
     const Role* findRole(const std::string& role_title) const;
+    RoleID findRoleID(const std::string& role_title) const;
     const std::string& getContentPath() const {return content_path;}
     const std::string getLogPath() const {return log_path;}
     const std::string getSecret() const {return secret;}
     const std::string getServerName() const {return host_name;}
     const SSLConfig* getSSL() const {return &ssl;}
+    const LoadSheddingConfig* getLoadShedding() const {return &load_shedding;}
+    const RevocationConfig* getRevocation() const {return &revocation;}
+    const BufferConfig* getBuffers() const {return &buffers;}
+    const TimeoutConfig* getTimeouts() const {return &timeouts;}
     std::string getHostIP() const {return host_address;}
     int getPort() const {return port;}
     std::size_t getThreadCount() const {return thread_count;}
@@ -103,16 +200,23 @@ class Config
     void operator=(Config&) = delete;
 
     void loadRoles(tinyxml2::XMLDocument* doc);
+    void compileRoles();
     void loadSSL(tinyxml2::XMLDocument* doc);
     void loadHostIP();
     void loadRoutes(tinyxml2::XMLDocument* doc, const std::string& content_path);
     void loadJWTSecret(tinyxml2::XMLDocument* doc);
+    void loadRevocation(tinyxml2::XMLDocument* doc);
+    void loadLogging(tinyxml2::XMLDocument* doc);
     void loadJWTSecretFromFile(tinyxml2::XMLElement* secret_elem);
     void generateJWTSecret(tinyxml2::XMLElement* secret_elem);
     void loadThreads(tinyxml2::XMLDocument* doc);
     void loadErrorPages(tinyxml2::XMLDocument* doc);
     void loadPipeline(tinyxml2::XMLDocument* doc);
+    void loadLoadShedding(tinyxml2::XMLDocument* doc);
+    void loadBuffers(tinyxml2::XMLDocument* doc);
+    void loadTimeouts(tinyxml2::XMLDocument* doc);
     std::unique_ptr<mw::Middleware> loadGlobalRateLimit(tinyxml2::XMLDocument* doc, bool* is_ip);
+    std::unique_ptr<mw::Middleware> loadGlobalConcurrencyLimit(tinyxml2::XMLDocument* doc);
 
     private:
     std::size_t thread_count{0};
@@ -121,6 +225,11 @@ class Config
     
     Roles roles;
     SSLConfig ssl;
+    LoadSheddingConfig load_shedding;
+    logger::RotationSetting log_rotation;
+    RevocationConfig revocation;
+    BufferConfig buffers;
+    TimeoutConfig timeouts;
     std::string secret;
     std::string content_path;
     std::string host_name;
@@ -1,4 +1,6 @@
 #include "http.h" 
+#include "Clock.h"
+#include "TimerWheel.h"
 std::string url_decode(std::string&& buf) {
     std::string decoded_buf;
     char hex_code[3] = {'\0'};
@@ -21,11 +23,7 @@ std::string url_decode(std::string&& buf) {
 }
 
 std::string http::get_time_stamp() {
-    std::ostringstream oss;
-    auto now = std::time(nullptr);
-    std::tm tm = *std::gmtime(&now);
-    oss << std::put_time(&tm, "%a, %d %b %Y %H:%M:%S GMT");
-    return oss.str();
+    return clk::Clock::getInstance()->now()->http_date;
 }
 
 http::code http::code_str_to_enum(const char* code_str) {
@@ -121,6 +119,7 @@ std::string_view http::get_status_msg(http::code http_code) {
     case http::code::Forbidden: return "HTTP/1.1 403 Forbidden";
     case http::code::Not_Found: return "HTTP/1.1 404 Not Found";
     case http::code::Method_Not_Allowed: return "HTTP/1.1 405 Method Not Allowed";
+    case http::code::Request_Timeout: return "HTTP/1.1 408 Request Timeout";
     case http::code::Unsupported_Media_Type: return "HTTP/1.1 415 Unsupported Media Type";
     case http::code::Too_Many_Requests: return "HTTP/1.1 429 Too Many Requests";
     case http::code::Client_Closed_Request: return "HTTP/1.1 499 Client Closed Request";
@@ -143,49 +142,53 @@ std::string_view http::extract_header_line(std::span<const char> buffer) {
     return response.substr(0, end);
 }
 
-std::string_view http::get_request_target(std::span<const char> buffer) {
+http::Result<std::string_view> http::get_request_target(std::span<const char> buffer) {
     std::string_view req{ buffer.data(), buffer.size() };
 
     auto a = req.find(' ');
     if (a == std::string_view::npos) {
-        throw HTTPException(code::Bad_Request,
-            "malformed request: no spaces");
+        return Error{code::Bad_Request, "malformed request: no spaces"};
     }
 
     auto b = req.find(' ', a + 1);
     if (b == std::string_view::npos) {
-        throw HTTPException(code::Bad_Request,
-            "malformed request: no second space");
+        return Error{code::Bad_Request, "malformed request: no second space"};
     }
 
     return req.substr(a + 1, b - a - 1);
 }
 
-std::string http::extract_endpoint(std::span<const char> buffer) {
+http::Result<std::string> http::extract_endpoint(std::span<const char> buffer) {
     auto target = get_request_target(buffer);
-    auto qpos = target.find('?');
+    if (!target) {
+        return std::move(target.error());
+    }
+    auto qpos = target->find('?');
     auto path = (qpos == std::string_view::npos
-                 ? target
-                 : target.substr(0, qpos));
+                 ? *target
+                 : target->substr(0, qpos));
     return std::string(path);
 }
 
-std::string_view http::extract_query_string(std::span<const char> buffer) {
+http::Result<std::string_view> http::extract_query_string(std::span<const char> buffer) {
     auto target = get_request_target(buffer);
+    if (!target) {
+        return std::move(target.error());
+    }
 
-    auto qpos = target.find('?');
+    auto qpos = target->find('?');
     if (qpos == std::string_view::npos) {
-        return {};
+        return std::string_view{};
     }
-    return target.substr(qpos + 1);
+    return target->substr(qpos + 1);
 }
 
-std::string_view http::extract_body(std::span<const char> buffer) {
+http::Result<std::string_view> http::extract_body(std::span<const char> buffer) {
     std::string_view header(buffer.data(), buffer.size());
 
     std::size_t start;
     if ((start = header.find("\r\n\r\n")) == std::string::npos && (start = header.find("\n\n")) == std::string::npos) {
-        throw http::HTTPException(http::code::Bad_Request, "Failed to extract body from buffer");
+        return http::Error{http::code::Bad_Request, "Failed to extract body from buffer"};
     }
     std::size_t offset = (header[start] == '\r') ? 4 : 2;
 
@@ -242,13 +245,16 @@ http::code http::build_json(std::span<const char> buffer, http::json& json_array
         return code;
     }
 
+    auto body = http::extract_body(buffer);
+    if(!body) {
+        return body.error().status;
+    }
+
     if(content_type == "application/x-www-form-urlencoded") {
-        std::string body = (std::string)http::extract_body(buffer);
-        json_array = http::parse_url_form(body);
+        json_array = http::parse_url_form(std::string(*body));
     }
     else if (content_type == "application/json") {
-        std::string_view body = http::extract_body(buffer);
-        json_array = http::json::parse(body);
+        json_array = http::json::parse(*body);
     }
     else {
         return http::code::Not_Implemented;
@@ -257,42 +263,42 @@ http::code http::build_json(std::span<const char> buffer, http::json& json_array
     return http::code::OK;
 }
 
- http::method http::extract_method(std::span<const char> buffer) {
+http::Result<http::method> http::extract_method(std::span<const char> buffer) {
     std::string_view header(buffer.data(), buffer.size());
     std::size_t line_end = header.find("\r\n");
     if (line_end == std::string_view::npos) {
-        throw http::HTTPException(http::code::Bad_Request, "failed to find return line feed while parsing request method");
+        return http::Error{http::code::Bad_Request, "failed to find return line feed while parsing request method"};
     }
     std::string_view request_line = header.substr(0, line_end);
 
     std::size_t method_end = request_line.find(' ');
     if (method_end == std::string_view::npos) {
-        throw http::HTTPException(http::code::Bad_Request, "failed to parse request method");
+        return http::Error{http::code::Bad_Request, "failed to parse request method"};
     }
     return http::method_str_to_enum(std::string(request_line.substr(0, method_end)));
     
 }
 
-std::unordered_map<std::string, std::string> http::extract_headers(std::span<const char> buffer) {
-    std::unordered_map<std::string, std::string> headers;
+/* adds the headers in buffer to headers, allocating from its allocator */
+http::Result<> http::extract_headers(std::span<const char> buffer, HeaderMap& headers) {
     std::string_view request(buffer.data(), buffer.size());
     const std::string_view line_end = "\r\n";
     const std::string_view header_splitter = ": ";
 
     std::size_t headers_end = request.find("\r\n\r\n");
     if (headers_end == std::string_view::npos) {
-        throw http::HTTPException(http::code::Bad_Request, "failed to extract headers from request buffer");
+        return http::Error{http::code::Bad_Request, "failed to extract headers from request buffer"};
     }
 
     std::size_t pos = 0;
     std::size_t end_of_request_line = request.find(line_end, pos);
     if (end_of_request_line == std::string_view::npos) {
-        throw http::HTTPException(http::code::Bad_Request, "failed to extract headers from request buffer");
+        return http::Error{http::code::Bad_Request, "failed to extract headers from request buffer"};
     }
     
     pos = end_of_request_line + line_end.size();
     if (pos >= headers_end) {
-        return headers;
+        return {};
     }
 
     while (true) {
@@ -301,7 +307,7 @@ std::unordered_map<std::string, std::string> http::extract_headers(std::span<con
         }
         std::size_t end = request.find(line_end, pos);
         if (end == std::string_view::npos) {
-            throw http::HTTPException(http::code::Bad_Request, "failed to extract headers from request buffer");
+            return http::Error{http::code::Bad_Request, "failed to extract headers from request buffer"};
         }
 
         std::string_view line = request.substr(pos, end - pos);
@@ -311,16 +317,14 @@ std::unordered_map<std::string, std::string> http::extract_headers(std::span<con
 
         std::size_t splitter_pos = line.find(header_splitter);
         if (splitter_pos == std::string_view::npos) {
-            throw http::HTTPException(http::code::Bad_Request, "failed to extract headers from request buffer");
+            return http::Error{http::code::Bad_Request, "failed to extract headers from request buffer"};
         }
 
-        std::string key = std::string(line.substr(0, splitter_pos));
-        std::string value = std::string(line.substr(splitter_pos + header_splitter.size()));
-
-        headers[std::move(key)] = std::move(value);
+        std::pmr::string key(line.substr(0, splitter_pos), headers.get_allocator());
+        headers[std::move(key)] = line.substr(splitter_pos + header_splitter.size());
         pos = end + line_end.size();
     }
-    return headers;
+    return {};
 }
 
 std::string http::extract_jwt_from_cookie(const std::string& cookie) {
@@ -449,67 +453,90 @@ static bool get_content_type(std::span<const char> buf, std::string& ct) {
     return true;
 }
 
-static std::string_view get_args(std::span<const char> buffer, const std::string& desired, bool (*filter)(std::string_view) ) {
+static http::Result<std::string_view> get_args(std::span<const char> buffer, const std::string& desired, bool (*filter)(std::string_view) ) {
     std::string content_type;
-    std::string_view body = http::extract_body(buffer);
+    auto body = http::extract_body(buffer);
+    if (!body) {
+        return body;
+    }
     if (!get_content_type(buffer, content_type)) {
-        throw http::HTTPException(http::code::Unsupported_Media_Type, std::format("expected={}, none provided", desired));
+        return http::Error{http::code::Unsupported_Media_Type, std::format("expected={}, none provided", desired)};
     }
     if (content_type != desired) {
-        throw http::HTTPException(http::code::Unsupported_Media_Type, std::format("expected={}, client claimed={}", desired, content_type));
+        return http::Error{http::code::Unsupported_Media_Type, std::format("expected={}, client claimed={}", desired, content_type)};
     }
-    if (!filter(body)) {
-        throw http::HTTPException(http::code::Bad_Request, std::format("invalid `{}` body", desired));
+    if (!filter(*body)) {
+        return http::Error{http::code::Bad_Request, std::format("invalid `{}` body", desired)};
     }
     return body;
 }
 
-static std::string_view body_any(std::span<const char> buffer) {
-    std::string_view body = http::extract_body(buffer);
+static http::Result<std::string_view> body_any(std::span<const char> buffer) {
+    auto body = http::extract_body(buffer);
     std::string content_type;
-    if(!get_content_type(buffer, content_type)) {
+    if(!body || !get_content_type(buffer, content_type)) {
         return body;
-    } else if(content_type == "application/json" && is_valid_json(body)) {
+    } else if(content_type == "application/json" && is_valid_json(*body)) {
         return body;
-    } else if(content_type == "application/x-www-form-urlencoded" && is_valid_url_form(body)) {
+    } else if(content_type == "application/x-www-form-urlencoded" && is_valid_url_form(*body)) {
         return body;
     } else if (content_type == "application/json" || content_type == "application/x-www-form-urlencoded") { // supported content type, but body was invalid
-        throw http::HTTPException(http::code::Bad_Request, std::format("invalid argument format in request body, client claimed={}", content_type));
+        return http::Error{http::code::Bad_Request, std::format("invalid argument format in request body, client claimed={}", content_type)};
     } else { // cannot validate this content-type, simply pass through
         return body;
     }
 }
 
-static std::string_view args_any(std::span<const char> buffer) {
-    std::string_view result;
-    if(!(result = http::extract_query_string(buffer)).empty()) {
+static http::Result<std::string_view> args_any(std::span<const char> buffer) {
+    auto result = http::extract_query_string(buffer);
+    if(!result || !result->empty()) {
         return result; // prioritize query string
     }
     return body_any(buffer);
 }
 
-std::string_view http::extract_args(std::span<const char> buffer, http::arg_type arg) {
+http::Result<std::string_view> http::extract_args(std::span<const char> buffer, http::arg_type arg) {
     switch(arg) {
-        case http::arg_type::None: return {};
+        case http::arg_type::None: return std::string_view{};
         case http::arg_type::Any: return args_any(buffer);
         case http::arg_type::Body_Any: return body_any(buffer);
         case http::arg_type::Body_JSON: return get_args(buffer, "application/json", is_valid_json);
         case http::arg_type::Body_URL: return get_args(buffer, "application/x-www-form-urlencoded", is_valid_url_form);
         case http::arg_type::Query_String: return http::extract_query_string(buffer);
         default:
-            throw http::HTTPException(http::code::Internal_Server_Error, "unknown arg type"); // should'nt ever reach, unless enum class gets updated
+            return http::Error{http::code::Internal_Server_Error, "unknown arg type"}; // should'nt ever reach, unless enum class gets updated
     }
 }
 
+/* arms the connection's write deadline for the size of a write, cleared when the write returns */
+struct WriteDeadline {
+    timer::Deadline* deadline;
+    WriteDeadline(Socket* sock, std::size_t bytes): deadline(sock->getDeadline()) {
+        if(deadline) {
+            deadline->arm(timer::phase::Write, bytes);
+        }
+    }
+    ~WriteDeadline() {
+        if(deadline) {
+            deadline->disarm();
+        }
+    }
+    /* a client that ran out of time is logged as a timeout rather than a disconnect */
+    http::code status(const asio::error_code& ec) const {
+        return (deadline && deadline->expired()) ? http::code::Request_Timeout : http::io::error_to_status(ec);
+    }
+};
+
 asio::awaitable<http::io::WriteStatus> http::io::co_write_all(Socket* sock, std::span<const char> buffer) noexcept {
+    WriteDeadline deadline(sock, buffer.size());
     TransferState state;
     state.bytes_sent = 0;
     state.total_bytes = buffer.size();
     while(state.bytes_sent < state.total_bytes) {
         auto [ec, bytes_written] = co_await sock->co_write(buffer.data() + state.bytes_sent, state.total_bytes - state.bytes_sent);
         
-        if(http::io::is_permanent_failure(ec) || state.retry_count > TransferState::MAX_RETRIES) {
-            co_return http::io::WriteStatus{http::io::error_to_status(ec), 
+        if((ec && !http::io::is_retryable(ec)) || state.retry_count > TransferState::MAX_RETRIES) {
+            co_return http::io::WriteStatus{deadline.status(ec), 
             std::format("error={} ({})", ec.value(), ec.message()), static_cast<std::size_t>(state.bytes_sent)};
         }
 
@@ -527,6 +554,87 @@ asio::awaitable<http::io::WriteStatus> http::io::co_write_all(Socket* sock, std:
     co_return http::io::WriteStatus{http::code::OK, "Success", static_cast<std::size_t>(state.bytes_sent)};
 }
 
+asio::awaitable<http::io::WriteStatus> http::io::co_write_all(Socket* sock, std::span<const asio::const_buffer> buffers) noexcept {
+    constexpr std::size_t MAX_GATHER = 8;
+    if(buffers.size() > MAX_GATHER) { // callers gather a header and a body or chunk, never close to the cap
+        co_return http::io::WriteStatus{http::code::Internal_Server_Error, 
+                std::format("gather of {} buffers exceeds the limit of {}", buffers.size(), MAX_GATHER), 0};
+    }
+    std::array<asio::const_buffer, MAX_GATHER> pending;
+    std::size_t count = buffers.size();
+    std::copy_n(buffers.begin(), count, pending.begin());
+
+    TransferState state;
+    state.total_bytes = asio::buffer_size(std::span<const asio::const_buffer>(pending.data(), count));
+    WriteDeadline deadline(sock, state.total_bytes);
+    std::size_t first = 0;
+    while(state.bytes_sent < state.total_bytes) {
+        auto [ec, bytes_written] = co_await sock->co_write(std::span<const asio::const_buffer>(pending.data() + first, count - first));
+
+        if((ec && !http::io::is_retryable(ec)) || state.retry_count > TransferState::MAX_RETRIES) {
+            co_return http::io::WriteStatus{deadline.status(ec), 
+            std::format("error={} ({})", ec.value(), ec.message()), static_cast<std::size_t>(state.bytes_sent)};
+        }
+
+        if(http::io::is_retryable(ec)) {
+            co_await http::io::backoff(ec, state.retry_count);
+            state.retry_count++;
+        }
+
+        state.bytes_sent += bytes_written;
+        while(first < count && bytes_written >= pending[first].size()) { // skip what was sent, resume mid buffer
+            bytes_written -= pending[first].size();
+            ++first;
+        }
+        if(first < count) {
+            pending[first] += bytes_written;
+        }
+    }
+    co_return http::io::WriteStatus{http::code::OK, "Success", static_cast<std::size_t>(state.bytes_sent)};
+}
+
+asio::awaitable<http::io::WriteStatus> http::io::co_sendfile_all(Socket* sock, int fd, off_t offset, std::size_t size) noexcept {
+    WriteDeadline deadline(sock, size);
+    TransferState state;
+    state.total_bytes = size;
+    while(state.bytes_sent < state.total_bytes) {
+        auto [ec, bytes_written] = co_await sock->co_sendfile(fd, offset + state.bytes_sent, state.total_bytes - state.bytes_sent);
+
+        if((ec && !http::io::is_retryable(ec)) || state.retry_count > TransferState::MAX_RETRIES) {
+            co_return http::io::WriteStatus{deadline.status(ec), 
+            std::format("error={} ({})", ec.value(), ec.message()), static_cast<std::size_t>(state.bytes_sent)};
+        }
+        if(!ec && bytes_written == 0) {
+            co_return http::io::WriteStatus{http::code::Internal_Server_Error, 
+            std::format("file ended early, sent {}/{} bytes", state.bytes_sent, state.total_bytes), static_cast<std::size_t>(state.bytes_sent)};
+        }
+
+        if(http::io::is_retryable(ec)) {
+            co_await http::io::backoff(ec, state.retry_count);
+            state.retry_count++;
+        }
+
+        state.bytes_sent += bytes_written;
+    }
+    co_return http::io::WriteStatus{http::code::OK, "Success", static_cast<std::size_t>(state.bytes_sent)};
+}
+
+asio::awaitable<http::io::WriteStatus> http::io::co_write_response(Socket* sock, Response* response, std::span<const char> body) noexcept {
+    if(body.empty()) {
+        body = std::span<const char>(response->body.data(), response->body.size());
+    }
+    std::span<const char> header = response->serializeHeaders();
+    std::array<asio::const_buffer, 2> buffers{asio::buffer(header.data(), header.size()), asio::buffer(body.data(), body.size())};
+    co_return co_await co_write_all(sock, std::span<const asio::const_buffer>(buffers));
+}
+
+asio::awaitable<http::io::WriteStatus> http::io::co_write_canned(Socket* sock, Response* response, std::string_view head, std::string_view body) noexcept {
+    std::span<const char> dynamic = response->serializeDynamicHeaders();
+    std::array<asio::const_buffer, 3> buffers{asio::buffer(head.data(), head.size()), asio::buffer(dynamic.data(), dynamic.size()), 
+                                              asio::buffer(body.data(), body.size())};
+    co_return co_await co_write_all(sock, std::span<const asio::const_buffer>(buffers));
+}
+
 std::chrono::milliseconds http::io::select_backoff(const asio::error_code& ec, int attempt) noexcept {
     if(!ec || http::io::is_client_disconnect(ec) || http::io::is_permanent_failure(ec)) {
         return std::chrono::milliseconds{0}; 
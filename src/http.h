@@ -12,6 +12,7 @@
 #include <string>
 #include <utility>
 #include <unordered_map>
+#include <memory_resource>
 #include <span>
 #include <cctype>
 #include <chrono>
@@ -43,6 +44,7 @@ namespace http
         Forbidden = 403,
         Not_Found = 404,
         Method_Not_Allowed = 405,
+        Request_Timeout = 408,
         Unsupported_Media_Type = 415,
         Too_Many_Requests = 429,
         Client_Closed_Request = 499,
@@ -94,16 +96,24 @@ namespace http
     std::string_view get_status_msg(code http_code);
     std::string get_time_stamp();
 
+    /* header maps of a transaction's request and response allocate from the transaction's arena */
+    using HeaderMap = std::pmr::unordered_map<std::pmr::string, std::pmr::string>;
+
     class Response {
         public:
+        using allocator_type = std::pmr::polymorphic_allocator<>;
+
         code status{code::OK};
         std::string status_msg{get_status_msg(code::OK)};
         std::string body{""};
-        std::unordered_map<std::string, std::string> headers;
+        HeaderMap headers;
         std::string built_response{""};
+        std::pmr::string header_buffer; // serialized status line and headers, keeps its capacity across writes
 
         Response() {}
+        explicit Response(allocator_type alloc): headers(alloc), header_buffer(alloc) {}
         Response(code new_status) {setStatus(new_status);}
+        Response(Error&& error) {setStatus(error.status); addHeaders(error.headers);}
 
         void setStatus(code new_status) {
             status = new_status;
@@ -112,26 +122,50 @@ namespace http
 
         void addHeaders(const std::unordered_map<std::string, std::string>& headers) {
             for (auto& [k,v] : headers) {
-                this->headers[k] = v;
+                addHeader(k, v);
             }
         }
 
-        void addHeader(std::string key, const std::string& val) {
-            headers[key] = val;
+        void addHeader(std::string_view key, std::string_view val) {
+            headers[std::pmr::string(key, headers.get_allocator())] = val;
         }
 
         std::string getStr() const {
             return built_response;
         }
 
-        std::string build() {
-            built_response = status_msg + "\r\n";
+        /* for prebuilt responses, serializes only the per request headers (Date and any added headers) and the blank line */
+        std::span<const char> serializeDynamicHeaders() {
+            header_buffer.clear();
+            header_buffer.append("Date: ").append(get_time_stamp()).append("\r\n");
+            for(auto& [key, value] : headers) {
+                header_buffer.append(key).append(": ").append(value).append("\r\n");
+            }
+            header_buffer.append("\r\n");
+            return std::span<const char>(header_buffer.data(), header_buffer.size());
+        }
 
+        /* serializes the status line and headers into header_buffer, the body is sent alongside it */
+        std::span<const char> serializeHeaders() {
             headers["Date"] = get_time_stamp();
+            std::size_t size = status_msg.size() + 4;
+            for(auto& [key, value] : headers) {
+                size += key.size() + value.size() + 4;
+            }
+            header_buffer.clear();
+            header_buffer.reserve(size);
+            header_buffer.append(status_msg).append("\r\n");
             for(auto& [key, value] : headers) {
-                built_response += key + ": " + value + "\r\n";
+                header_buffer.append(key).append(": ").append(value).append("\r\n");
             }
-            return built_response + "\r\n" + body;
+            header_buffer.append("\r\n");
+            return std::span<const char>(header_buffer.data(), header_buffer.size());
+        }
+
+        std::string build() {
+            serializeHeaders();
+            built_response = header_buffer;
+            return built_response + body;
         }
 
         http::code getStatus() const {return status;}
@@ -142,16 +176,13 @@ namespace http
 
             HTTPException() {}
 
-            HTTPException(code status, std::string&& message): response(status), message(std::move(message)) {
-                response.addHeader("Connection", "close");
-                response.addHeader("Content-Length", "0"); 
-                response.build();
-            }
-            HTTPException(code status, std::string&& message, std::unordered_map<std::string, std::string>&& headers): response(status), message(std::move(message)) {
+            /* nothing is serialized here, error pages send a prebuilt response with only the headers given here spliced in */
+            HTTPException(code status, std::string&& message): response(status), message(std::move(message)) {}
+            HTTPException(code status, std::string&& message, const std::unordered_map<std::string, std::string>& headers): response(status), message(std::move(message)) {
                 response.addHeaders(headers);
-                response.addHeader("Connection", "close");
-                response.addHeader("Content-Length", "0"); 
-                response.build();
+            }
+            HTTPException(Error&& error): response(error.status), message(std::move(error.message)) {
+                response.addHeaders(error.headers);
             }
 
             const Response* getResponse() const {return &response;}
@@ -165,31 +196,37 @@ namespace http
     };
 
     struct Request {
+        using allocator_type = std::pmr::polymorphic_allocator<>;
+
         http::method method;
         std::string_view query;
         std::string_view args;
         std::string endpoint_url;
         const http::Endpoint* endpoint{nullptr};
         const http::EndpointMethod* route{nullptr};
-        std::unordered_map<std::string, std::string> headers;
+        HeaderMap headers;
         std::string_view body;
 
-        void addHeader(std::string key, std::string value) {headers[key] = value;}
+        Request() {}
+        explicit Request(allocator_type alloc): headers(alloc) {}
+
+        void addHeader(std::string_view key, std::string_view value) {headers[std::pmr::string(key, headers.get_allocator())] = value;}
 
-        std::string getHeader(std::string key) {
-            auto it = headers.find(key);
+        std::string getHeader(std::string_view key) {
+            auto it = headers.find(std::pmr::string(key, headers.get_allocator()));
             if(it == headers.end()) {
                 return "";
             }
-            return it->second;
+            return std::string(it->second);
         }
     };
 
     bool is_success_code(http::code status) noexcept;
 
-    method extract_method(std::span<const char> buffer);
+    /* the request parsers return a malformed request as an Error, the caller decides how to answer it */
+    Result<method> extract_method(std::span<const char> buffer);
     code extract_token(const std::vector<char>& buffer, std::string& token);
-    std::unordered_map<std::string, std::string> extract_headers(std::span<const char> buffer);
+    Result<> extract_headers(std::span<const char> buffer, HeaderMap& headers);
     code extract_status_code(std::span<const char> buffer) noexcept;
     std::string extract_jwt_from_cookie(const std::string& cookie);
 
@@ -199,13 +236,13 @@ namespace http
     code build_json(std::span<const char> buffer, json& json_array);
     json parse_url_form(const std::string& body);
     std::string_view extract_header_line(std::span<const char> buffer);
-    std::string_view extract_body(std::span<const char> buffer);
+    Result<std::string_view> extract_body(std::span<const char> buffer);
     code find_content_type(std::span<const char> buffer, std::string& content_type) noexcept;
-    std::string_view get_request_target(std::span<const char> buffer);
-    std::string extract_endpoint(std::span<const char> buffer);
-    std::string_view extract_query_string(std::span<const char> buffer);
+    Result<std::string_view> get_request_target(std::span<const char> buffer);
+    Result<std::string> extract_endpoint(std::span<const char> buffer);
+    Result<std::string_view> extract_query_string(std::span<const char> buffer);
     code determine_content_type(const std::string& resource, std::string& content_type);
-    std::string_view extract_args(std::span<const char> buffer, http::arg_type arg);
+    Result<std::string_view> extract_args(std::span<const char> buffer, http::arg_type arg);
 
     namespace io {
         struct WriteStatus {
@@ -215,6 +252,13 @@ namespace http
         };        
 
         asio::awaitable<WriteStatus> co_write_all(Socket* sock, std::span<const char> buffer) noexcept;
+        asio::awaitable<WriteStatus> co_write_all(Socket* sock, std::span<const asio::const_buffer> buffers) noexcept;
+        /* sends size bytes of the file from offset straight from the page cache, the socket must be able to (Socket::canSendFile) */
+        asio::awaitable<WriteStatus> co_sendfile_all(Socket* sock, int fd, off_t offset, std::size_t size) noexcept;
+        /* sends the response's headers and body (response->body if body is empty) in one gathered write */
+        asio::awaitable<WriteStatus> co_write_response(Socket* sock, Response* response, std::span<const char> body = {}) noexcept;
+        /* sends a prebuilt status line and headers, the response's dynamic headers, then the prebuilt body */
+        asio::awaitable<WriteStatus> co_write_canned(Socket* sock, Response* response, std::string_view head, std::string_view body) noexcept;
         std::chrono::milliseconds select_backoff(const asio::error_code& ec, int retry) noexcept; 
         asio::awaitable<void> backoff(const asio::error_code& ec, int retry) noexcept;
         
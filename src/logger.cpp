@@ -1,5 +1,6 @@
 #include "logger.h"
 #include "config.h"
+#include "Clock.h"
 
 using namespace logger;
 
@@ -8,8 +9,16 @@ static int duration_ms(const std::chrono::time_point<std::chrono::system_clock>&
 }
 
 std::string logger::get_time() {
-    auto now = std::chrono::system_clock::now();
+    return get_time(std::chrono::system_clock::now());
+}
+
+std::string logger::get_time(std::chrono::system_clock::time_point now) {
     std::time_t time = std::chrono::system_clock::to_time_t(now);
+    const clk::Snapshot* snapshot = clk::Clock::getInstance()->now();
+    if(snapshot->seconds / 60 == time / 60) { // timestamps are to the minute, nearly every entry hits
+        return snapshot->log_time;
+    }
+
     std::tm local_time = *std::localtime(&time);
 
     std::ostringstream oss;
@@ -31,14 +40,6 @@ static std::string format_bytes(long bytes) {
 }
 
 
-static void trim_user_agent(std::string& user_agent) {
-    std::string user_agent_label = "User-Agent: ";
-    if (user_agent.find(user_agent_label) == 0) 
-    {
-        user_agent = user_agent.substr(user_agent_label.length());
-    }
-}
-
 static std::string get_identifier(const std::string& user_agent) {
     std::string result;
     std::size_t identifier_end = user_agent.find("(");
@@ -115,28 +116,51 @@ std::string logger::get_stack_trace() {
     return oss.str();
 }
 
-std::string logger::get_user_agent(const char* buffer, std::size_t size) {
+std::string_view logger::get_user_agent(const char* buffer, std::size_t size) {
+    static constexpr std::string_view user_agent_label = "User-Agent: ";
     std::size_t ua_start, ua_end;
     std::string_view buffer_str(buffer, size);
-    if((ua_start = buffer_str.find("User-Agent")) == std::string::npos)
+    if((ua_start = buffer_str.find(user_agent_label)) == std::string::npos)
         return "";
+    ua_start += user_agent_label.length();
     if((ua_end = buffer_str.find("\r\n", ua_start)) == std::string::npos)
         return "";
+    return buffer_str.substr(ua_start, ua_end - ua_start);
+}
 
-    std::string user_agent(buffer_str.substr(ua_start, ua_end - ua_start));
-    trim_user_agent(user_agent);
+std::string logger::classify_user_agent(std::string_view raw_user_agent) {
+    std::string user_agent(raw_user_agent);
     return get_identifier(user_agent) + get_os(user_agent) + get_browser(user_agent);
 }
 
-std::string logger::get_header_line(const char* buffer, std::size_t size) {
+const std::string& UserAgentCache::classify(std::string_view raw_user_agent) {
+    std::size_t hash = std::hash<std::string_view>{}(raw_user_agent);
+    auto it = index.find(hash);
+    if(it != index.end() && it->second->raw == raw_user_agent) {
+        entries.splice(entries.begin(), entries, it->second); // most recently used
+        return it->second->classified;
+    }
+    if(it != index.end()) { // hash collision, the newer agent takes the slot
+        entries.erase(it->second);
+        index.erase(it);
+    } else if (entries.size() >= USER_AGENT_CACHE_SIZE) {
+        index.erase(entries.back().hash);
+        entries.pop_back();
+    }
+    entries.push_front(CachedAgent{hash, std::string(raw_user_agent), classify_user_agent(raw_user_agent)});
+    index[hash] = entries.begin();
+    return entries.front().classified;
+}
+
+std::string_view logger::get_header_line(const char* buffer, std::size_t size) {
     std::size_t end;
     std::string_view header(buffer, size);
     if((end = header.find("\r\n")) == std::string::npos)
         return "";
-    return std::string(header.substr(0, end));
+    return header.substr(0, end);
 }
 
-static std::string level_to_str(logger::level level) {
+std::string logger::level_to_str(logger::level level) {
     switch(level) {
         case level::Trace: return "TRACE";
         case level::Debug: return "DEBUG";
@@ -149,20 +173,154 @@ static std::string level_to_str(logger::level level) {
     }
 }
 
+void ArgBuffer::putString(const char* str) {
+    std::size_t len = std::strlen(str);
+    if(len <= UINT16_MAX && size + 1 + sizeof(std::uint16_t) + len <= data.size()) {
+        std::uint16_t short_len = static_cast<std::uint16_t>(len);
+        data[size++] = static_cast<char>(tag::String);
+        std::memcpy(data.data() + size, &short_len, sizeof(short_len));
+        size += sizeof(short_len);
+        std::memcpy(data.data() + size, str, len);
+        size += len;
+        return;
+    }
+    std::uint32_t location[2] = {static_cast<std::uint32_t>(spill.size()), static_cast<std::uint32_t>(len)};
+    if(size + 1 + sizeof(location) > data.size()) {
+        return;
+    }
+    data[size++] = static_cast<char>(tag::Spilled);
+    std::memcpy(data.data() + size, location, sizeof(location));
+    size += sizeof(location);
+    spill.append(str, len);
+}
+
+/* 
+ * Minimal printf over the serialized args. Each conversion spec is copied (flags, width, precision), 
+ * its length modifier replaced to match the stored width, and passed to snprintf with the stored value.
+ */
+std::string ArgBuffer::format(const char* fmt) const {
+    std::string out;
+    out.reserve(128);
+    std::size_t pos = 0;
+    char spec[32], buf[128];
+
+    for(const char* p = fmt; *p; ++p) {
+        if(*p != '%') {
+            out += *p;
+            continue;
+        }
+        if(*(p + 1) == '%') {
+            out += '%';
+            ++p;
+            continue;
+        }
+
+        std::size_t spec_len = 0;
+        spec[spec_len++] = '%';
+        ++p;
+        while(*p && std::strchr("-+ #0123456789.", *p) && spec_len < sizeof(spec) - 4) {
+            spec[spec_len++] = *p++;
+        }
+        while(*p && std::strchr("hlLqjzt", *p)) {
+            ++p; // length modifiers are dropped, values are stored at full width
+        }
+        if(!*p) {
+            break;
+        }
+        char conversion = *p;
+
+        if(pos >= size) {
+            out += "(missing)";
+            continue;
+        }
+        tag t = static_cast<tag>(data[pos++]);
+        long long i = 0;
+        unsigned long long u = 0;
+        double d = 0;
+        const void* ptr = nullptr;
+        std::string_view str;
+        switch(t) {
+            case tag::Int: std::memcpy(&i, data.data() + pos, sizeof(i)); pos += sizeof(i); u = static_cast<unsigned long long>(i); d = static_cast<double>(i); break;
+            case tag::Uint: std::memcpy(&u, data.data() + pos, sizeof(u)); pos += sizeof(u); i = static_cast<long long>(u); d = static_cast<double>(u); break;
+            case tag::Double: std::memcpy(&d, data.data() + pos, sizeof(d)); pos += sizeof(d); i = static_cast<long long>(d); u = static_cast<unsigned long long>(i); break;
+            case tag::Pointer: std::memcpy(&ptr, data.data() + pos, sizeof(ptr)); pos += sizeof(ptr); u = reinterpret_cast<std::uintptr_t>(ptr); i = static_cast<long long>(u); break;
+            case tag::String: {
+                std::uint16_t len;
+                std::memcpy(&len, data.data() + pos, sizeof(len));
+                pos += sizeof(len);
+                str = std::string_view(data.data() + pos, len);
+                pos += len;
+                break;
+            }
+            case tag::Spilled: {
+                std::uint32_t location[2];
+                std::memcpy(location, data.data() + pos, sizeof(location));
+                pos += sizeof(location);
+                str = std::string_view(spill).substr(location[0], location[1]);
+                break;
+            }
+        }
+
+        int len = 0;
+        switch(conversion) {
+            case 'd': case 'i':
+                std::memcpy(spec + spec_len, "lld", 4);
+                len = std::snprintf(buf, sizeof(buf), spec, i);
+                break;
+            case 'u': case 'x': case 'X': case 'o':
+                spec[spec_len] = 'l'; spec[spec_len + 1] = 'l'; spec[spec_len + 2] = conversion; spec[spec_len + 3] = '\0';
+                len = std::snprintf(buf, sizeof(buf), spec, u);
+                break;
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+                spec[spec_len] = conversion; spec[spec_len + 1] = '\0';
+                len = std::snprintf(buf, sizeof(buf), spec, d);
+                break;
+            case 'c':
+                spec[spec_len] = 'c'; spec[spec_len + 1] = '\0';
+                len = std::snprintf(buf, sizeof(buf), spec, static_cast<int>(i));
+                break;
+            case 'p':
+                spec[spec_len] = 'p'; spec[spec_len + 1] = '\0';
+                len = std::snprintf(buf, sizeof(buf), spec, ptr ? ptr : reinterpret_cast<const void*>(static_cast<std::uintptr_t>(u)));
+                break;
+            case 's':
+                if(spec_len == 1) {
+                    out += str; // the common plain %s, no copy through snprintf
+                } else {
+                    std::string value(str);
+                    spec[spec_len] = 's'; spec[spec_len + 1] = '\0';
+                    int needed = std::snprintf(nullptr, 0, spec, value.c_str());
+                    if(needed > 0) {
+                        std::size_t offset = out.size();
+                        out.resize(offset + needed + 1);
+                        std::snprintf(out.data() + offset, needed + 1, spec, value.c_str());
+                        out.resize(offset + needed);
+                    }
+                }
+                continue;
+            default:
+                out += "(bad format)";
+                continue;
+        }
+        if(len > 0) {
+            out.append(buf, std::min<std::size_t>(len, sizeof(buf) - 1));
+        }
+    }
+    return out;
+}
+
 std::string InlineEntry::build() {
-    std::string level_str = level_to_str(level) + " ";
-    std::string curr_time = "[" + get_time() +"] ";
-    context = "[" + context + "] ";
-    std::string res = curr_time + level_str + context + message;
+    std::string res = "[" + get_time(time) + "] " + level_to_str(level) + " [" + context + "] " + args.format(format_str);
     res += (level != logger::level::Status && level != logger::level::Info) ?
             " (" + std::string(file) + ":" + std::to_string(line) + ", " + std::string(function) + ")" : "";
     return res + "\n";
 }
 
 std::string SessionEntry::build() {
-    std::string time = "[" + get_time() + "] ";
-    std::string client = " [client " + client_addr + "] "; 
-    std::string request_str = "\"" + request + "\" ";
+    thread_local UserAgentCache user_agents; // only the logger thread builds entries outside of shutdown
+    std::string time_str = "[" + get_time(time) + "] ";
+    std::string client = " [client " + std::string(client_addr.view()) + "] "; 
+    std::string request_str = "\"" + std::string(request.view()) + "\" ";
     std::string latency_RTT_size = " [Latency: " + std::to_string(duration_ms(Latency_start_time, Latency_end_time)) 
                                  + " ms RTT: "  + std::to_string(duration_ms(RTT_start_time, RTT_end_time)) + " ms";
     if(bytes != 0) {
@@ -170,7 +328,60 @@ std::string SessionEntry::build() {
     }
     latency_RTT_size += "] ";
     
-    return time + level_to_str(level) + client + request_str + user_agent + latency_RTT_size + response + "\n";
+    return time_str + level_to_str(level) + client + request_str + user_agents.classify(user_agent.view()) + latency_RTT_size + std::string(response.view()) + "\n";
+}
+
+/*
+ * Entry storage, one fixed size slot per entry. A producer takes slots from its thread's cache and the logger thread
+ * returns them to its own, so slots move between threads through a shared depot in batches of half a cache. The
+ * caches are trivially destructible, a thread's cache is simply abandoned when it exits, and the depot is declared
+ * ahead of the logger so it outlives the entries the logger frees on shutdown. Steady state logging doesn't allocate.
+ */
+static constexpr std::size_t ENTRY_SLOT_SIZE = std::max(sizeof(InlineEntry), sizeof(SessionEntry));
+static constexpr std::size_t ENTRY_CACHE_SIZE = 2 * logger::STAGING_BLOCK_SIZE;
+
+struct EntryCache {
+    std::array<void*, ENTRY_CACHE_SIZE> slots;
+    std::size_t count;
+};
+static thread_local EntryCache entry_cache{};
+static std::mutex entry_depot_mutex;
+static std::vector<void*> entry_depot;
+
+void* Entry::operator new(std::size_t size) {
+    if(size > ENTRY_SLOT_SIZE) {
+        return ::operator new(size);
+    }
+    if(entry_cache.count == 0) {
+        std::lock_guard<std::mutex> lock(entry_depot_mutex);
+        std::size_t take = std::min(entry_depot.size(), ENTRY_CACHE_SIZE / 2);
+        std::copy(entry_depot.end() - take, entry_depot.end(), entry_cache.slots.begin());
+        entry_depot.resize(entry_depot.size() - take);
+        entry_cache.count = take;
+    }
+    if(entry_cache.count == 0) {
+        return ::operator new(ENTRY_SLOT_SIZE);
+    }
+    return entry_cache.slots[--entry_cache.count];
+}
+
+void Entry::operator delete(void* ptr, std::size_t size) noexcept {
+    if(size > ENTRY_SLOT_SIZE) {
+        ::operator delete(ptr);
+        return;
+    }
+    if(entry_cache.count == ENTRY_CACHE_SIZE) {
+        std::size_t give = ENTRY_CACHE_SIZE / 2;
+        try {
+            std::lock_guard<std::mutex> lock(entry_depot_mutex);
+            entry_depot.insert(entry_depot.end(), entry_cache.slots.end() - give, entry_cache.slots.end());
+            entry_cache.count -= give;
+        } catch (const std::exception&) {
+            ::operator delete(ptr); // the depot couldn't grow, free this one instead
+            return;
+        }
+    }
+    entry_cache.slots[entry_cache.count++] = ptr;
 }
 
 Logger Logger::INSTANCE;
@@ -188,86 +399,394 @@ void Logger::addSink(std::unique_ptr<Sink>&& sink) {
     sink_count++;
 }
 
-void Logger::push(std::unique_ptr<logger::Entry>&& entry) {
-    std::size_t pos = head.fetch_add(1, std::memory_order_release);
-    std::size_t index = pos % logger::LOG_BUFFER_SIZE; 
-    log_buffer[index] = std::move(entry);
+logger::level logger::level_str_to_enum(const std::string& level_str, logger::level fallback) noexcept {
+    if(level_str == "trace") {
+        return level::Trace;
+    } else if (level_str == "debug") {
+        return level::Debug;
+    } else if (level_str == "info") {
+        return level::Info;
+    } else if (level_str == "warn") {
+        return level::Warn;
+    } else if (level_str == "error") {
+        return level::Error;
+    }
+    return fallback;
 }
 
-std::unique_ptr<logger::Entry> Logger::pop() {
-    std::size_t curr_tail = tail.load(std::memory_order_relaxed);
-    std::size_t curr_head = head.load(std::memory_order_acquire);
+/* capped at error, fatal and status entries can't be silenced */
+void logger::Logger::setThreshold(logger::level threshold) {
+    if(static_cast<int>(threshold) > static_cast<int>(level::Error)) {
+        threshold = level::Error;
+    }
+    log_threshold.store(threshold, std::memory_order_relaxed);
+}
+
+logger::full_policy logger::full_policy_str_to_enum(const std::string& policy_str) noexcept {
+    if(policy_str == "drop_oldest") {
+        return full_policy::Drop_Oldest;
+    } else if (policy_str == "block") {
+        return full_policy::Block;
+    }
+    return full_policy::Drop_Newest;
+}
+
+EntryQueue::EntryQueue() {
+    for(std::size_t i = 0; i < LOG_BUFFER_SIZE; ++i) {
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+/* leaves entry untouched if the queue is full */
+bool EntryQueue::tryPush(std::unique_ptr<logger::Entry>& entry) {
+    std::size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    Slot* slot;
+    while(true) {
+        slot = &slots[pos & MASK];
+        std::size_t seq = slot->sequence.load(std::memory_order_acquire);
+        std::intptr_t diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+        if(diff == 0) {
+            if(enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false; // the slot still holds an entry from the previous lap
+        } else {
+            pos = enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+    slot->entry = std::move(entry);
+    slot->sequence.store(pos + 1, std::memory_order_release); // publish
+    return true;
+}
+
+/* reserves count consecutive slots with a single CAS, all or nothing */
+bool EntryQueue::tryPushBatch(std::unique_ptr<logger::Entry>* entries, std::size_t count) {
+    if(count == 0 || count > LOG_BUFFER_SIZE) {
+        return count == 0;
+    }
+    std::size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    while(true) {
+        std::size_t last = pos + count - 1;
+        std::size_t seq = slots[last & MASK].sequence.load(std::memory_order_acquire);
+        std::intptr_t diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(last);
+        if(diff == 0) {
+            if(enqueue_pos.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+
+    for(std::size_t i = 0; i < count; ++i) {
+        Slot& slot = slots[(pos + i) & MASK];
+        while(slot.sequence.load(std::memory_order_acquire) != pos + i) {
+            std::this_thread::yield(); // the last slot was free, so earlier ones are already claimed by a consumer and about to be released
+        }
+        slot.entry = std::move(entries[i]);
+        slot.sequence.store(pos + i + 1, std::memory_order_release);
+    }
+    return true;
+}
+
+bool EntryQueue::tryPop(std::unique_ptr<logger::Entry>& entry) {
+    std::size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+    Slot* slot;
+    while(true) {
+        slot = &slots[pos & MASK];
+        std::size_t seq = slot->sequence.load(std::memory_order_acquire);
+        std::intptr_t diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+        if(diff == 0) {
+            if(dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false; // empty, or the producer hasn't published yet
+        } else {
+            pos = dequeue_pos.load(std::memory_order_relaxed);
+        }
+    }
+    entry = std::move(slot->entry);
+    slot->sequence.store(pos + LOG_BUFFER_SIZE, std::memory_order_release); // free for the next lap
+    return true;
+}
+
+namespace {
+    struct LocalStaging {
+        logger::StagingSlot* slot{nullptr};
+        ~LocalStaging() {
+            if(slot) {
+                logger::Logger::getInstance()->releaseStaging(slot);
+            }
+        }
+    };
+    thread_local LocalStaging local_staging;
+}
+
+StagingSlot* Logger::localStaging() {
+    if(!local_staging.slot) {
+        auto slot = new StagingSlot();
+        slot->block.store(&slot->storage, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(staging_mutex);
+        staging_slots.push_back(slot);
+        local_staging.slot = slot;
+    }
+    return local_staging.slot;
+}
 
-    std::size_t entries_not_flushed = curr_head - curr_tail;
-    if(entries_not_flushed >= logger::LOG_BUFFER_SIZE) { // buffer overun, drop old entries
-        tail.store(curr_head - logger::LOG_BUFFER_SIZE + 1, std::memory_order_relaxed);
-        curr_tail = tail.load(std::memory_order_relaxed);
+void Logger::releaseStaging(StagingSlot* slot) {
+    StagingBlock* block;
+    while(!(block = slot->block.exchange(nullptr, std::memory_order_acquire))) {
+        std::this_thread::yield(); // the logger is collecting it
     }
+    handOff(block, slot);
 
-    if(curr_tail >= curr_head) {
-        return nullptr; // no logs to write
+    std::lock_guard<std::mutex> lock(staging_mutex);
+    std::erase(staging_slots, slot);
+    delete slot;
+}
+
+/* moves a staged block into the queue in one reservation, entries that don't fit go through the full policy */
+void Logger::handOff(StagingBlock* block, StagingSlot* slot) {
+    if(block->count == 0) {
+        return;
+    }
+    if(!log_buffer.tryPushBatch(block->entries.data(), block->count)) {
+        for(std::size_t i = 0; i < block->count; ++i) {
+            enqueue(std::move(block->entries[i]));
+        }
     }
-    tail.fetch_add(1, std::memory_order_release);
-    return std::move(log_buffer[curr_tail % logger::LOG_BUFFER_SIZE]);
+    block->count = 0;
+    slot->staged.store(0, std::memory_order_relaxed);
+    wake();
+}
+
+/* stages the entry in the calling thread's block, fatal entries skip staging since the process is about to exit */
+void Logger::push(std::unique_ptr<logger::Entry>&& entry) {
+    entry->time = std::chrono::system_clock::now();
+    if(entry->level == logger::level::Fatal) {
+        enqueue(std::move(entry));
+        return;
+    }
+
+    StagingSlot* slot = localStaging();
+    StagingBlock* block = slot->block.exchange(nullptr, std::memory_order_acquire);
+    if(!block) {
+        enqueue(std::move(entry));
+        return;
+    }
+
+    if(block->count == 0) {
+        block->first_at = entry->time;
+    }
+    bool stale = entry->time - block->first_at >= logger::STAGING_TIMEOUT;
+    block->entries[block->count++] = std::move(entry);
+    slot->staged.store(block->count, std::memory_order_relaxed);
+    if(block->count == logger::STAGING_BLOCK_SIZE || stale) {
+        handOff(block, slot);
+    } else if (block->count == 1) {
+        wake(); // a sleeping logger needs a timeout to collect this block if the thread goes quiet
+    }
+    slot->block.store(block, std::memory_order_release);
+}
+
+void Logger::enqueue(std::unique_ptr<logger::Entry>&& entry) {
+    if(log_buffer.tryPush(entry)) {
+        wake();
+        return;
+    }
+
+    switch(policy.load(std::memory_order_relaxed)) {
+        case full_policy::Drop_Oldest: {
+            std::unique_ptr<logger::Entry> oldest;
+            do {
+                if(log_buffer.tryPop(oldest)) {
+                    dropped_oldest.fetch_add(1, std::memory_order_relaxed);
+                }
+            } while(!log_buffer.tryPush(entry));
+            wake();
+            return;
+        }
+        case full_policy::Block:
+            while(running.load(std::memory_order_acquire)) { // nothing drains a stopped logger, drop instead
+                std::this_thread::yield();
+                if(log_buffer.tryPush(entry)) {
+                    wake();
+                    return;
+                }
+            }
+            [[fallthrough]];
+        default:
+            dropped_newest.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+std::unique_ptr<logger::Entry> Logger::pop() {
+    std::unique_ptr<logger::Entry> entry;
+    log_buffer.tryPop(entry);
+    return entry;
+}
+
+DropStats Logger::getDropStats() const {
+    return DropStats{dropped_newest.load(std::memory_order_relaxed), dropped_oldest.load(std::memory_order_relaxed)};
+}
+
+/* written straight to the sinks, a report pushed to a full queue would be dropped too */
+static std::string build_drop_report(const DropStats& stats, std::uint64_t dropped) {
+    return std::format("[{}] WARN [Logger] log queue full, dropped {} entries [total newest={} oldest={}]\n", 
+        logger::get_time(), dropped, stats.dropped_newest, stats.dropped_oldest);
 }
 
 void Logger::stopAndFlush() {
     running.store(false, std::memory_order_release);
     if(worker_handle.joinable()) {
+        if(wakeup_fd != -1) {
+            std::uint64_t one = 1;
+            (void)::write(wakeup_fd, &one, sizeof(one));
+        }
         worker_handle.join();
     }
     
-    if(entries > 0) { // flush the batch first
+    collectStaged();
+    while(true) { // the worker has exited, drain whatever is left
+        drain();
+        if(entries == 0) {
+            break;
+        }
         flush();
     }
+}
 
-    std::string log = "";
-    std::unique_ptr<logger::Entry> entry;
-    while((entry = pop()) != nullptr) {
-        log = entry->build();
-        for(int i = 0; i < sink_count; ++i) { // flush remaining one by one
-            sinks[i]->write(log);
+/* adds to the batch on the logger thread, used for entries that don't come through the queue */
+void Logger::append(std::unique_ptr<logger::Entry>&& entry) {
+    if(entries >= logger::ENTRY_BATCH_SIZE) {
+        flush();
+    }
+    if(entries == 0) {
+        batch_start = std::chrono::steady_clock::now();
+    }
+    batch[entries++] = std::move(entry);
+}
+
+/* takes the blocks of threads that have staged entries but not handed them off */
+void Logger::collectStaged() {
+    std::lock_guard<std::mutex> lock(staging_mutex);
+    for(StagingSlot* slot : staging_slots) {
+        if(slot->staged.load(std::memory_order_relaxed) == 0) {
+            continue;
+        }
+        StagingBlock* block = slot->block.exchange(nullptr, std::memory_order_acquire);
+        if(!block) {
+            continue; // the owner is appending, it or the next collection will hand it off
         }
+        for(std::size_t i = 0; i < block->count; ++i) {
+            append(std::move(block->entries[i]));
+        }
+        block->count = 0;
+        slot->staged.store(0, std::memory_order_relaxed);
+        slot->block.store(block, std::memory_order_release);
     }
 }
 
+bool Logger::hasStaged() {
+    std::lock_guard<std::mutex> lock(staging_mutex);
+    return std::any_of(staging_slots.begin(), staging_slots.end(), [](StagingSlot* slot) { 
+        return slot->staged.load(std::memory_order_relaxed) > 0; 
+    });
+}
+
+/* hands each built entry to the sinks, which buffer them and write the batch out on flush */
 void Logger::flush() {
-    std::string logs = "";
-    for(int i = 0; i < entries; ++i) {
-        logs += batch[i]->build();
-    }   
-    for(int i = 0; i < sink_count; ++i) {
-        if(sinks[i] != nullptr) {
-            sinks[i]->write(logs);
+    DropStats stats = getDropStats();
+    std::uint64_t dropped = stats.dropped_newest + stats.dropped_oldest;
+    if(dropped != dropped_reported) {
+        std::string report = build_drop_report(stats, dropped - dropped_reported);
+        for(std::size_t i = 0; i < sink_count; ++i) {
+            sinks[i]->write(report);
         }
+        dropped_reported = dropped;
+    }
+    std::stable_sort(batch.begin(), batch.begin() + entries, [](const auto& a, const auto& b) { 
+        return a->time < b->time; // blocks from different threads arrive interleaved
+    });
+    for(std::size_t i = 0; i < entries; ++i) {
+        std::string log = batch[i]->build();
+        for(std::size_t j = 0; j < sink_count; ++j) {
+            sinks[j]->write(log);
+        }
+        batch[i].reset();
+    }   
+    for(std::size_t i = 0; i < sink_count; ++i) {
+        sinks[i]->flush();
     }
     entries = 0;
 }
 
-void Logger::processBatch() {
-    bool timeout = (std::chrono::steady_clock::now() - last_flush) >= logger::BATCH_TIMEOUT;
-    if (entries > 0 && timeout) {
-        flush();
-        last_flush = std::chrono::steady_clock::now();
+/* moves everything queued into the batch, returns true if the batch filled up */
+bool Logger::drain() {
+    while(entries < logger::ENTRY_BATCH_SIZE && log_buffer.tryPop(batch[entries])) {
+        if(entries == 0) {
+            batch_start = std::chrono::steady_clock::now();
+        }
+        entries++;
     }
-    
-    auto entry = pop();
-    if(entry == nullptr) {
+    return entries >= logger::ENTRY_BATCH_SIZE;
+}
+
+/* called by producers after publishing an entry, costs a syscall only when the worker is asleep */
+void Logger::wake() {
+    std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with the fence in wait(), orders the publish before reading the flag
+    if(wakeup_fd != -1 && waiting.load(std::memory_order_relaxed) && waiting.exchange(false, std::memory_order_relaxed)) {
+        std::uint64_t one = 1;
+        (void)::write(wakeup_fd, &one, sizeof(one));
+    }
+}
+
+/* sleeps until a producer signals, the timeout expires or the logger is stopped */
+void Logger::wait(std::chrono::milliseconds timeout) {
+    waiting.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::size_t before = entries;
+    if(drain() || entries != before || !running.load(std::memory_order_acquire)) { // an entry landed before the flag was seen
+        waiting.store(false, std::memory_order_relaxed);
         return;
     }
 
-    batch[entries] = std::move(entry);
-    entries++;
-    if (entries >= logger::ENTRY_BATCH_SIZE) {
-        flush();
-        last_flush = std::chrono::steady_clock::now();
+    pollfd pfd{wakeup_fd, POLLIN, 0}; // poll ignores a negative fd, without an eventfd this degrades to a timed sleep
+    int timeout_ms = (wakeup_fd == -1 && timeout.count() < 0) ? static_cast<int>(logger::BATCH_TIMEOUT.count()) : static_cast<int>(timeout.count());
+    if(::poll(&pfd, 1, timeout_ms) > 0 && (pfd.revents & POLLIN)) {
+        std::uint64_t count;
+        (void)::read(wakeup_fd, &count, sizeof(count));
     }
+    waiting.store(false, std::memory_order_relaxed);
 }
 
 void Logger::run() {
     while (running.load(std::memory_order_acquire)) {
-        processBatch();
-        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        bool full = drain();
+        auto now = std::chrono::steady_clock::now();
+        if(now - last_collect >= logger::STAGING_TIMEOUT) {
+            collectStaged();
+            last_collect = now;
+        }
+        auto age = now - batch_start;
+        if(full || (entries > 0 && age >= logger::BATCH_TIMEOUT)) {
+            flush();
+            continue;
+        }
+
+        auto timeout = std::chrono::milliseconds(-1);
+        if(entries > 0) {
+            timeout = std::chrono::ceil<std::chrono::milliseconds>(logger::BATCH_TIMEOUT - age);
+        }
+        if(hasStaged()) {
+            auto collect_in = std::chrono::ceil<std::chrono::milliseconds>(logger::STAGING_TIMEOUT - (now - last_collect));
+            timeout = timeout.count() < 0 ? collect_in : std::min(timeout, collect_in);
+        }
+        wait(timeout);
     }
     if(entries > 0) {
         flush();
@@ -275,14 +794,16 @@ void Logger::run() {
 }
 
 void Logger::start() {
+    if((wakeup_fd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) < 0) {
+        perror("logger eventfd failed, falling back to polling");
+    }
     this->running = true;
     this->worker_handle = std::thread(&logger::Logger::run, this);
 }
 
 Logger::~Logger() {
     stopAndFlush();
+    if(wakeup_fd != -1) {
+        ::close(wakeup_fd);
+    }
 }
-
-
-
-
@@ -18,47 +18,166 @@
 #include <atomic>
 #include <memory>
 #include <array>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+#include <type_traits>
+#include <string_view>
 #include <execinfo.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 
 #include "Sink.h"
 
 namespace logger 
 { 
     std::string get_time();
+    std::string get_time(std::chrono::system_clock::time_point time);
     std::string fmt_msg(const char* fmt, ...);
     std::string get_stack_trace();
-    std::string get_user_agent(const char* buffer, std::size_t size);
-    std::string get_header_line(const char* buffer, std::size_t size);
+    std::string_view get_user_agent(const char* buffer, std::size_t size); // the raw header value, a view into buffer
+    std::string classify_user_agent(std::string_view raw_user_agent);
+    std::string_view get_header_line(const char* buffer, std::size_t size);
 
     constexpr std::size_t MAX_SINKS = 1024;
-    constexpr std::size_t LOG_BUFFER_SIZE = 1024;
-    constexpr std::size_t ENTRY_BATCH_SIZE = 10;
+    constexpr std::size_t LOG_BUFFER_SIZE = 8192; // must be a power of 2
+    constexpr std::size_t ENTRY_BATCH_SIZE = 4096; // flush once this many entries are batched
     constexpr auto BATCH_TIMEOUT = std::chrono::milliseconds(10);
+    constexpr std::size_t STAGING_BLOCK_SIZE = 64; // entries a thread stages before handing them off
+    constexpr auto STAGING_TIMEOUT = std::chrono::milliseconds(10); // bounds how long an entry sits in a quiet thread's block
 
     enum class level {
         Trace, Debug, Info, Warn, Error, Fatal, Status 
     };
 
+    /* What push does when the queue is full */
+    enum class full_policy {
+        Drop_Newest, Drop_Oldest, Block
+    };
+    full_policy full_policy_str_to_enum(const std::string& policy_str) noexcept;
+    std::string level_to_str(logger::level level);
+    /* returns fallback if level_str doesn't name trace, debug, info, warn or error */
+    logger::level level_str_to_enum(const std::string& level_str, logger::level fallback) noexcept;
+
+    struct DropStats {
+        std::uint64_t dropped_newest{0};
+        std::uint64_t dropped_oldest{0};
+    };
+
+    constexpr std::size_t USER_AGENT_CACHE_SIZE = 512;
+
+    /* 
+     * Bounded LRU of classified user agents keyed by the raw header's hash, a few hundred agents
+     * cover nearly all traffic so parsing is rare. Not thread safe, each building thread has its own.
+     */
+    class UserAgentCache {
+        public:
+        const std::string& classify(std::string_view raw_user_agent);
+
+        private:
+        struct CachedAgent {
+            std::size_t hash;
+            std::string raw; // confirms hits, the hash alone may collide
+            std::string classified;
+        };
+        std::list<CachedAgent> entries; // most recently used first
+        std::unordered_map<std::size_t, std::list<CachedAgent>::iterator> index;
+    };
+
+    constexpr std::size_t ARG_BUFFER_SIZE = 256;
+
+    /* 
+     * printf arguments serialized at the call site as tagged binary values, strings are copied since the
+     * caller's buffers may not outlive the call. Formatting happens later on the logger thread.
+     */
+    class ArgBuffer {
+        public:
+        enum class tag : std::uint8_t { Int, Uint, Double, Pointer, String, Spilled };
+
+        template <typename... Args>
+        void encode(const Args&... args) {(put(args), ...);}
+        std::string format(const char* fmt) const;
+
+        private:
+        std::array<char, ARG_BUFFER_SIZE> data;
+        std::size_t size{0};
+        std::string spill; // strings that don't fit in data, only allocated for oversized args (e.g. stack traces)
+
+        template <typename T>
+        void put(const T& arg) {
+            if constexpr (std::is_same_v<T, const char*> || std::is_same_v<T, char*>) {
+                putString(arg ? arg : "(null)");
+            } else if constexpr (std::is_array_v<T>) {
+                putString(arg);
+            } else if constexpr (std::is_enum_v<T>) {
+                putValue(tag::Int, static_cast<long long>(arg));
+            } else if constexpr (std::is_floating_point_v<T>) {
+                putValue(tag::Double, static_cast<double>(arg));
+            } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+                putValue(tag::Int, static_cast<long long>(arg));
+            } else if constexpr (std::is_integral_v<T>) {
+                putValue(tag::Uint, static_cast<unsigned long long>(arg));
+            } else if constexpr (std::is_pointer_v<T>) {
+                putValue(tag::Pointer, reinterpret_cast<const void*>(arg));
+            } else {
+                static_assert(std::is_pointer_v<T>, "unsupported log argument type, pass printf compatible values");
+            }
+        }
+
+        template <typename V>
+        void putValue(tag t, V value) {
+            if(size + 1 + sizeof(V) > data.size()) {
+                return; // formatted as "(missing)"
+            }
+            data[size++] = static_cast<char>(t);
+            std::memcpy(data.data() + size, &value, sizeof(V));
+            size += sizeof(V);
+        }
+        void putString(const char* str);
+    };
+
+    template <std::size_t N>
+    struct FixedString {
+        char data[N];
+        std::uint16_t length{0};
+
+        FixedString& operator=(std::string_view str) {
+            length = static_cast<std::uint16_t>(std::min(str.size(), N));
+            std::memcpy(data, str.data(), length);
+            return *this;
+        }
+        std::string_view view() const {return std::string_view(data, length);}
+        bool empty() const {return length == 0;}
+    };
+
     struct Entry {
         int line;
         const char* file;
         const char* function;
         logger::level level;
-        std::string message;
+        std::chrono::system_clock::time_point time; // set when logged, batches are ordered by it
         virtual std::string build() = 0;
+        virtual ~Entry() = default;
+
+        /* entries are recycled through per thread caches instead of the heap, see logger.cpp */
+        static void* operator new(std::size_t size);
+        static void operator delete(void* ptr, std::size_t size) noexcept;
     };
 
     struct InlineEntry: public Entry {
-        std::string context;
+        const char* context;
+        const char* format_str;
+        ArgBuffer args;
         std::string build() override;
     };
 
     struct SessionEntry : public Entry {
         unsigned long bytes{0};
-        std::string user_agent{""}; 
-        std::string request{""};
-        std::string response{""};
-        std::string client_addr{""};
+        FixedString<256> user_agent; // raw header value, classified when the entry is built
+        FixedString<256> request;
+        FixedString<64> response;
+        FixedString<64> client_addr;
         std::chrono::time_point<std::chrono::system_clock> Latency_start_time;
         std::chrono::time_point<std::chrono::system_clock> Latency_end_time;
         std::chrono::time_point<std::chrono::system_clock> RTT_start_time;
@@ -66,6 +185,48 @@ namespace logger
         std::string build() override;
     };
 
+    /* 
+     * Bounded queue with a sequence number per slot (Vyukov), a slot is only read once its sequence
+     * publishes it. The logger thread is the only regular consumer, but dequeue is multi-consumer 
+     * safe so producers can evict the oldest entry under the Drop_Oldest policy.
+     */
+    class EntryQueue {
+        public:
+        EntryQueue();
+        bool tryPush(std::unique_ptr<logger::Entry>& entry);
+        bool tryPushBatch(std::unique_ptr<logger::Entry>* entries, std::size_t count);
+        bool tryPop(std::unique_ptr<logger::Entry>& entry);
+
+        private:
+        static constexpr std::size_t MASK = LOG_BUFFER_SIZE - 1;
+        static_assert((LOG_BUFFER_SIZE & MASK) == 0, "LOG_BUFFER_SIZE must be a power of 2");
+
+        struct Slot {
+            std::atomic<std::size_t> sequence;
+            std::unique_ptr<logger::Entry> entry;
+        };
+        std::array<Slot, LOG_BUFFER_SIZE> slots;
+        alignas(64) std::atomic<std::size_t> enqueue_pos{0};
+        alignas(64) std::atomic<std::size_t> dequeue_pos{0};
+    };
+
+    struct StagingBlock {
+        std::array<std::unique_ptr<logger::Entry>, STAGING_BLOCK_SIZE> entries;
+        std::size_t count{0};
+        std::chrono::system_clock::time_point first_at; // when the oldest staged entry was logged
+    };
+
+    /* 
+     * A producer thread's staging block. The owner appends without touching shared cache lines, the block 
+     * pointer is exchanged out by whoever works on it, so the logger can collect a quiet thread's block 
+     * and the owner falls back to the queue if it finds the block taken.
+     */
+    struct StagingSlot {
+        std::atomic<StagingBlock*> block;
+        std::atomic<std::size_t> staged{0}; // mirrors block->count for the logger's scan
+        StagingBlock storage;
+    };
+
     class Logger {
         public:
         static Logger* getInstance();
@@ -73,6 +234,15 @@ namespace logger
         void push(std::unique_ptr<logger::Entry>&& entry);
         void start();
         void stopAndFlush();
+        void setFullPolicy(logger::full_policy policy) {this->policy.store(policy, std::memory_order_relaxed);}
+        void setThreshold(logger::level threshold);
+        logger::level getThreshold() const {return log_threshold.load(std::memory_order_relaxed);}
+        /* checked by the log macros before an entry is built, fatal and status entries are always enabled */
+        static bool isEnabled(logger::level lvl) {
+            return static_cast<int>(lvl) >= static_cast<int>(INSTANCE.log_threshold.load(std::memory_order_relaxed));
+        }
+        DropStats getDropStats() const;
+        void releaseStaging(StagingSlot* slot); // called on thread exit, hands off and unregisters the thread's block
 
         private:
         static Logger INSTANCE;
@@ -80,17 +250,25 @@ namespace logger
         std::array<std::unique_ptr<Sink>, MAX_SINKS> sinks;
         std::size_t sink_count{0};
 
-        std::array<std::unique_ptr<logger::Entry>, logger::LOG_BUFFER_SIZE> log_buffer;
-        std::atomic<std::size_t> head{0};
-        std::atomic<std::size_t> tail{0};
+        EntryQueue log_buffer;
+        std::atomic<logger::full_policy> policy{full_policy::Drop_Newest};
+        std::atomic<std::uint64_t> dropped_newest{0};
+        std::atomic<std::uint64_t> dropped_oldest{0};
+        std::uint64_t dropped_reported{0};
     
         std::size_t entries{0};
-        std::chrono::time_point<std::chrono::steady_clock> last_flush{std::chrono::steady_clock::now()};
+        std::chrono::time_point<std::chrono::steady_clock> batch_start; // when the oldest batched entry was popped
         std::array<std::unique_ptr<logger::Entry>, ENTRY_BATCH_SIZE> batch;
 
         std::atomic<bool> running;
         std::thread worker_handle;
-        std::atomic<logger::level> log_threshold;
+        int wakeup_fd{-1}; // eventfd, signaled by producers only while the worker sleeps on an empty queue
+        alignas(64) std::atomic<bool> waiting{false};
+        std::atomic<logger::level> log_threshold{level::Trace};
+
+        std::mutex staging_mutex; // guards the registry, not the blocks
+        std::vector<StagingSlot*> staging_slots;
+        std::chrono::time_point<std::chrono::steady_clock> last_collect;
 
         private: 
         ~Logger();
@@ -99,7 +277,15 @@ namespace logger
         void operator=(Logger&) = delete;
 
         void run();
-        void processBatch();
+        void enqueue(std::unique_ptr<logger::Entry>&& entry);
+        StagingSlot* localStaging();
+        void handOff(StagingBlock* block, StagingSlot* slot);
+        void collectStaged();
+        bool hasStaged();
+        void append(std::unique_ptr<logger::Entry>&& entry);
+        bool drain();
+        void wait(std::chrono::milliseconds timeout);
+        void wake();
         std::unique_ptr<logger::Entry> pop();
         void flush(); 
     };
@@ -3,16 +3,18 @@
 
 #include "logger.h"
 
+/* compile time floor, entries above it are filtered at runtime by the logger's threshold */
 #ifndef CURRENT_LOG_LEVEL
 #define CURRENT_LOG_LEVEL logger::level::Trace
 #endif
 
 #define _LOG_INLINE(lvl, ctx, fmt, ...)                                  \
     do {                                                                 \
-        if (static_cast<int>(lvl) >= static_cast<int>(CURRENT_LOG_LEVEL)) {\
+        if (static_cast<int>(lvl) >= static_cast<int>(CURRENT_LOG_LEVEL) && logger::Logger::isEnabled(lvl)) {\
             auto entry = std::make_unique<logger::InlineEntry>();         \
             entry->level = lvl;                                            \
-            entry->message = logger::fmt_msg(fmt, ##__VA_ARGS__);          \
+            entry->format_str = "" fmt; /* literals only, formatted later on the logger thread */ \
+            entry->args.encode(__VA_ARGS__);                               \
             entry->context = ctx; \
             if(lvl != logger::level::Status && lvl != logger::level::Info) { \
                 entry->function = __func__;  \